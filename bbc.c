@@ -3,6 +3,16 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include "bbc.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 // bitboard data type
 typedef unsigned long long U64; 
@@ -179,26 +189,32 @@ char promoted_pieces[] = { [Q] = 'q', [R] = 'r', [B] = 'b', [N] = 'n',
 //
 //                           a b c d e f g h
 
-U64 bitboards[12];                                                                                                     // piece bitboards
-U64 occupancies[3];                                                                                                    // occupancy bitboards
-int side;                                                                                                              // side to move
-int enpassant               = no_sq;                                                                                   // enpassant square
-int castle;                                                                                                            // castling rights
-U64 hash_key;                                                                                                          // "almost" unique position identifier aka hash key or position key
-U64 repetition_table[1000];                                                                                            // 1000 is a number of plies (500 moves) in the entire game positions repetition table
-int repetition_index;                                                                                                  // repetition index
-int ply;                                                                                                               // half move counter
+_Thread_local U64 bitboards[12];                                                                                       // piece bitboards
+_Thread_local U64 occupancies[3];                                                                                      // occupancy bitboards
+_Thread_local int side;                                                                                                // side to move
+_Thread_local int enpassant               = no_sq;                                                                     // enpassant square
+_Thread_local int castle;                                                                                              // castling rights
+_Thread_local U64 hash_key;                                                                                            // "almost" unique position identifier aka hash key or position key
+_Thread_local U64 material_key;                                                                                        // material signature (sum of piece counts times random piece keys)
+_Thread_local int fifty;                                                                                               // fifty move rule counter (half moves since last capture or pawn move)
+_Thread_local U64* repetition_table;                                                                                   // hash keys of the positions played in the game & the current search line
+_Thread_local int  repetition_size;                                                                                    // repetition table capacity (grows with the game)
+_Thread_local int  repetition_index;                                                                                   // repetition index
+_Thread_local int ply;                                                                                                 // half move counter
 
 // Time controls variables
-int quit      =  0;                                                                                                    // exit from engine flag
-int movestogo = 30;                                                                                                    // UCI "movestogo" command moves counter
-int movetime  = -1;                                                                                                    // UCI "movetime" command time counter
-int time      = -1;                                                                                                    // UCI "time" command holder (ms)
-int inc       =  0;                                                                                                    // UCI "inc" command's time increment holder
-int starttime =  0;                                                                                                    // UCI "starttime" command time holder
-int stoptime  =  0;                                                                                                    // UCI "stoptime" command time holder
-int timeset   =  0;                                                                                                    // variable to flag time control availability
-int stopped   =  0;                                                                                                    // variable to flag when the time is up
+_Thread_local int quit      =  0;                                                                                      // exit from engine flag
+_Thread_local int starttime =  0;                                                                                      // UCI "starttime" command time holder
+_Thread_local int stoptime  =  0;                                                                                      // UCI "stoptime" command time holder
+_Thread_local int timeset   =  0;                                                                                      // variable to flag time control availability
+_Thread_local U64 nodes;                                                                                               // nodes searched (perft: leaf nodes reached at the given depth)
+_Thread_local U64 stopnodes =  0;                                                                                      // UCI "nodes" command's node limit (0 if none)
+_Thread_local int stopped   =  0;                                                                                      // variable to flag when the time is up
+_Thread_local int gui_input =  1;                                                                                      // listen to GUI input during search (batch workers don't)
+_Thread_local int verbose   =  1;                                                                                      // print "info" & "bestmove" lines (batch workers don't)
+_Thread_local void (*search_poll)(void);                                                                               // library host's callback, polled like the GUI input
+int               stop_requests;                                                                                       // bbc_stop() calls so far (atomic)
+_Thread_local int stop_request;                                                                                        // stop_requests when this thread's search started
 
 //  Miscellaneous functions
 //     forked from VICE
@@ -243,13 +259,14 @@ read_input()
   char input[256] = "", *endc;                                                                                         // GUI/user input
 
   if (input_waiting()) {                                                                                               // "listen" to STDIN
-    stopped = 1;                                                                                                       // tell engine to stop calculating
-
     do {                                                                                                               // loop to read bytes from STDIN
       bytes = read(fileno(stdin), input, 256);                                                                         // read bytes from STDIN
     }
     while (bytes < 0);                                                                                                 // until bytes available
 
+    if (bytes == 0) return;                                                                                            // end of input (e.g. "bbc bench < /dev/null"); keep calculating
+    stopped = 1;                                                                                                       // tell engine to stop calculating
+
     endc = strchr(input, '\n');                                                                                        // searches for the first occurrence of '\n'
     if (endc) *endc = 0;                                                                                               // if found new line set value at pointer to 0
     if (strlen(input) > 0) {                                                                                           // if input is available
@@ -266,7 +283,10 @@ communicate()
   if (timeset == 1 && get_time_ms() > stoptime) {                                                                      // if time is up break here
     stopped = 1;                                                                                                       // tell engine to stop calculating
   }
-  read_input();                                                                                                        // read GUI input
+  if (stopnodes && nodes >= stopnodes) stopped = 1;                                                                    // so is the node budget
+  if (gui_input) read_input();                                                                                         // read GUI input
+  if (search_poll) search_poll();                                                                                      // or let the library's host read its input
+  if (__atomic_load_n(&stop_requests, __ATOMIC_RELAXED) != stop_request) stopped = 1;                                  // bbc_stop() (from any thread)
 }
 
 // Random numbers
@@ -337,6 +357,7 @@ U64 piece_keys[12][64];
 U64 enpassant_keys[64];                                                                                                // random enpassant keys [square]
 U64 castle_keys[16];                                                                                                   // random castling keys
 U64 side_key;                                                                                                          // random side key
+U64 material_keys[12];                                                                                                 // random material keys [piece]
 
 // init random hash keys
 void
@@ -351,6 +372,8 @@ init_random_keys()
   for (int index = 0;  index  < 16; index++)                                                                           // loop over castling keys
     castle_keys[index] = get_random_U64_number();                                                                      // init castling keys
   side_key = get_random_U64_number();                                                                                  // ???: init random side key
+  for (int piece = P; piece <= k; piece++)                                                                             // loop over piece codes
+    material_keys[piece] = get_random_U64_number();                                                                    // init random material keys
 }
 
 // generate "almost" unique position ID aka hash key from scratch
@@ -375,6 +398,18 @@ generate_hash_key()
   return final_key;
 }
 
+// generate material key from scratch
+U64
+generate_material_key()
+{
+  U64 final_key = 0ULL;                                                                                                // final material key
+
+  for (int piece = P; piece <= k; piece++)                                                                             // loop over piece bitboards
+    final_key += count_bits(bitboards[piece]) * material_keys[piece];                                                  // add a key per piece
+
+  return final_key;
+}
+
 // Input & Output
 
 void
@@ -440,9 +475,9 @@ parse_fen(char* fen)
   enpassant        = no_sq;
   side             = 0;
   castle           = 0;
+  fifty            = 0;
   repetition_index = 0;                                                                                                // reset repetition index
-
-  memset(repetition_table, 0ULL, sizeof(repetition_table));                                                            // reset repetition table
+  repetition_table[0] = 0ULL;                                                                                          // reset repetition table
 
   for   (int rank = 0; rank < 8; rank++) {
     for (int file = 0; file < 8; file++) {
@@ -487,6 +522,10 @@ parse_fen(char* fen)
     enpassant = rank * 8 + file;                                                                                       // init enpassant square
   }
   else enpassant = no_sq;                                                                                              // no enpassant square
+
+  fen += (*fen == '-') ? 1 : 2;                                                                                        // go to parsing half move clock
+  while (*fen == ' ') fen++;
+  if (*fen >= '0' && *fen <= '9') fifty = atoi(fen);                                                                   // parse half move clock (optional)
   for (int piece = P; piece <= K; piece++)                                                                             // loop over white pieces bitboards
     occupancies[WHITE] |= bitboards[piece];                                                                            // populate white occupancy bitboard
   for (int piece = p; piece <= k; piece++)                                                                             // loop over black pieces bitboards
@@ -494,7 +533,36 @@ parse_fen(char* fen)
   occupancies[BOTH] |= occupancies[WHITE];                                                                             // init all occupancies
   occupancies[BOTH] |= occupancies[BLACK];
 
-  hash_key = generate_hash_key();
+  hash_key     = generate_hash_key();
+  material_key = generate_material_key();
+}
+
+// write the FEN string of the current position (buffer of at least 100 chars)
+void
+generate_fen(char* fen, int fullmove)
+{
+  for   (int rank = 0; rank < 8; rank++) {
+    int empty = 0;                                                                                                     // empty squares in a row
+    for (int file = 0; file < 8; file++) {
+      int piece = -1;
+      for (int bb_piece = P; bb_piece <= k; bb_piece++)
+        if (get_bit(bitboards[bb_piece], rank * 8 + file)) piece = bb_piece;
+
+      if (piece == -1) { empty++; continue; }
+      if (empty) *fen++ = '0' + empty, empty = 0;
+      *fen++ = ascii_pieces[piece];
+    }
+    if (empty) *fen++ = '0' + empty;
+    if (rank < 7) *fen++ = '/';
+  }
+
+  fen += sprintf(fen, " %c ", side == WHITE ? 'w' : 'b');
+  if (castle & WK) *fen++ = 'K';
+  if (castle & WQ) *fen++ = 'Q';
+  if (castle & BK) *fen++ = 'k';
+  if (castle & BQ) *fen++ = 'q';
+  if (castle == 0) *fen++ = '-';
+  sprintf(fen, " %s %d %d", enpassant == no_sq ? "-" : square_to_coordinates[enpassant], fifty, fullmove);
 }
 
 // Attacks
@@ -860,11 +928,205 @@ get_queen_attacks(Square square, U64 occupancy)
   return queen_attacks;
 }
 
-// Move generator
+Bitboard between_squares[64][64];                                                                                      // squares strictly between two squares on a common line [square][square]
 
-// is square current given attacked by the current given side
+// init squares between two squares sharing a rank, file or diagonal
+void
+init_between_squares()
+{
+  for   (Square square1 = 0; square1 < 64; square1++) {
+    for (Square square2 = 0; square2 < 64; square2++) {
+      Bitboard target1 = 1ULL << square1;
+      Bitboard target2 = 1ULL << square2;
+
+      if      (bishop_attacks_on_the_fly(square1, 0ULL) & target2)                                                     // same diagonal
+        between_squares[square1][square2] = bishop_attacks_on_the_fly(square1, target2) &
+                                            bishop_attacks_on_the_fly(square2, target1);
+      else if (rook_attacks_on_the_fly(square1, 0ULL) & target2)                                                       // same rank or file
+        between_squares[square1][square2] = rook_attacks_on_the_fly(square1, target2) &
+                                            rook_attacks_on_the_fly(square2, target1);
+    }
+  }
+}
+
+// NNUE
+
+//   efficiently updatable neural network (optional evaluation, UCI "UseNNUE" & "EvalFile")
+//
+//   768 inputs (piece * 64 + square, seen from each side) -> 256 hidden x 2 (clipped ReLU) -> 1 output
+//
+//   weight file (little endian int16): feature weights [768][256], feature biases [256],
+//                                      output weights [512] (side to move first), output bias
+
+#define nnue_inputs     768                                                                                            /* input features */
+#define nnue_hidden     256                                                                                            /* hidden neurons per perspective */
+#define nnue_qa         255                                                                                            /* accumulator quantization (clipped ReLU maximum) */
+#define nnue_qb         64                                                                                             /* output weights quantization */
+#define nnue_scale      400                                                                                            /* network output to centipawns */
+#define nnue_stack_size 256                                                                                            /* accumulators of the positions of a search line (deeper than max_ply) */
+
+short nnue_feature_weights[nnue_inputs][nnue_hidden];                                                                  // input -> hidden weights [feature][neuron]
+short nnue_feature_biases[nnue_hidden];                                                                                // hidden biases [neuron]
+short nnue_output_weights[2 * nnue_hidden];                                                                            // hidden -> output weights [side to move neurons, opponent neurons]
+short nnue_output_bias;                                                                                                // output bias
+
+_Thread_local short nnue_accumulators[nnue_stack_size][2][nnue_hidden];                                                // hidden layer sums [position][perspective][neuron]
+_Thread_local int   nnue_ply;                                                                                          // accumulator of the current position (saved & restored with the board)
+int   nnue_loaded;                                                                                                     // a network has been loaded
+int   use_nnue;                                                                                                        // evaluate with the network (UCI "UseNNUE")
+
+// input feature of a piece on a square seen from the given side
+#define nnue_feature(perspective, piece, square)                                                                       \
+  ((perspective) == WHITE ? (piece) * 64 + (square) : (((piece) + 6) % 12) * 64 + ((square) ^ 56))
+
+// compute accumulator from the previous one by adding & removing features (one perspective)
+void
+nnue_update_perspective(short* output, const short* input, int* added, int added_count, int* removed, int removed_count)
+{
+#if defined(__AVX2__)
+  for (int index = 0; index < nnue_hidden; index += 16) {                                                              // 16 neurons per 256-bit register
+    __m256i sum = _mm256_loadu_si256((const __m256i*)(input + index));
+    for (int feature = 0; feature < added_count; feature++)
+      sum = _mm256_add_epi16(sum, _mm256_loadu_si256((const __m256i*)(nnue_feature_weights[added[feature]] + index)));
+    for (int feature = 0; feature < removed_count; feature++)
+      sum = _mm256_sub_epi16(sum, _mm256_loadu_si256((const __m256i*)(nnue_feature_weights[removed[feature]] + index)));
+    _mm256_storeu_si256((__m256i*)(output + index), sum);
+  }
+#elif defined(__SSE2__)
+  for (int index = 0; index < nnue_hidden; index += 8) {                                                               // 8 neurons per 128-bit register
+    __m128i sum = _mm_loadu_si128((const __m128i*)(input + index));
+    for (int feature = 0; feature < added_count; feature++)
+      sum = _mm_add_epi16(sum, _mm_loadu_si128((const __m128i*)(nnue_feature_weights[added[feature]] + index)));
+    for (int feature = 0; feature < removed_count; feature++)
+      sum = _mm_sub_epi16(sum, _mm_loadu_si128((const __m128i*)(nnue_feature_weights[removed[feature]] + index)));
+    _mm_storeu_si128((__m128i*)(output + index), sum);
+  }
+#else
+  for (int index = 0; index < nnue_hidden; index++) {                                                                  // scalar fallback
+    int sum = input[index];
+    for (int feature = 0; feature < added_count; feature++)   sum += nnue_feature_weights[added[feature]][index];
+    for (int feature = 0; feature < removed_count; feature++) sum -= nnue_feature_weights[removed[feature]][index];
+    output[index] = sum;
+  }
+#endif
+}
+
+// compute the accumulator of the current position from scratch
+void
+nnue_refresh()
+{
+  for (int perspective = WHITE; perspective <= BLACK; perspective++) {
+    short* accumulator = nnue_accumulators[nnue_ply][perspective];
+    memcpy(accumulator, nnue_feature_biases, sizeof(nnue_feature_biases));
+
+    for (int piece = P; piece <= k; piece++) {                                                                         // add every piece on the board
+      Bitboard bitboard = bitboards[piece];
+      while (bitboard) {
+        int square  = get_ls1b_index(bitboard);
+        int feature = nnue_feature(perspective, piece, square);
+        nnue_update_perspective(accumulator, accumulator, &feature, 1, NULL, 0);
+        pop_bit(bitboard, square);
+      }
+    }
+  }
+}
+
+// update the accumulator after a move has been made (pieces given as [piece, square] pairs)
+void
+nnue_make_move(int* added, int added_count, int* removed, int removed_count)
+{
+  if (nnue_ply == nnue_stack_size - 1) {                                                                               // out of accumulators (long move list of "position"):
+    nnue_refresh();                                                                                                    // recompute the current one in place
+    return;
+  }
+  nnue_ply++;
+
+  for (int perspective = WHITE; perspective <= BLACK; perspective++) {
+    int added_features[2], removed_features[2];
+    for (int index = 0; index < added_count; index++)
+      added_features[index]   = nnue_feature(perspective, added[2 * index],   added[2 * index + 1]);
+    for (int index = 0; index < removed_count; index++)
+      removed_features[index] = nnue_feature(perspective, removed[2 * index], removed[2 * index + 1]);
+
+    nnue_update_perspective(nnue_accumulators[nnue_ply][perspective], nnue_accumulators[nnue_ply - 1][perspective],
+                            added_features, added_count, removed_features, removed_count);
+  }
+}
+
+// sum of clipped ReLU hidden neurons times output weights (one perspective)
 int
-is_square_attacked(Square square, int side)
+nnue_output_sum(const short* accumulator, const short* weights)
+{
+#if defined(__AVX2__)
+  __m256i zero = _mm256_setzero_si256();
+  __m256i qa   = _mm256_set1_epi16(nnue_qa);
+  __m256i sum  = _mm256_setzero_si256();
+  for (int index = 0; index < nnue_hidden; index += 16) {
+    __m256i neurons = _mm256_min_epi16(_mm256_max_epi16(_mm256_loadu_si256((const __m256i*)(accumulator + index)), zero), qa);
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(neurons, _mm256_loadu_si256((const __m256i*)(weights + index))));
+  }
+  __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));                         // horizontal sum
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4e));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xb1));
+  return _mm_cvtsi128_si32(half);
+#elif defined(__SSE2__)
+  __m128i zero = _mm_setzero_si128();
+  __m128i qa   = _mm_set1_epi16(nnue_qa);
+  __m128i sum  = _mm_setzero_si128();
+  for (int index = 0; index < nnue_hidden; index += 8) {
+    __m128i neurons = _mm_min_epi16(_mm_max_epi16(_mm_loadu_si128((const __m128i*)(accumulator + index)), zero), qa);
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(neurons, _mm_loadu_si128((const __m128i*)(weights + index))));
+  }
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));                                                              // horizontal sum
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+  return _mm_cvtsi128_si32(sum);
+#else
+  int sum = 0;
+  for (int index = 0; index < nnue_hidden; index++) {                                                                  // scalar fallback
+    int neuron = accumulator[index];
+    if (neuron < 0)       neuron = 0;
+    if (neuron > nnue_qa) neuron = nnue_qa;
+    sum += neuron * weights[index];
+  }
+  return sum;
+#endif
+}
+
+// evaluate the current position with the network (side to move perspective)
+int
+nnue_evaluate()
+{
+  int sum = nnue_output_sum(nnue_accumulators[nnue_ply][side],     nnue_output_weights) +
+            nnue_output_sum(nnue_accumulators[nnue_ply][side ^ 1], nnue_output_weights + nnue_hidden);
+  return (sum + nnue_output_bias) * nnue_scale / (nnue_qa * nnue_qb);
+}
+
+// load network weights from a file, returns 1 on success
+int
+nnue_load(char* path)
+{
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) return 0;
+
+  int loaded = fread(nnue_feature_weights, sizeof(nnue_feature_weights), 1, file) == 1 &&
+               fread(nnue_feature_biases,  sizeof(nnue_feature_biases),  1, file) == 1 &&
+               fread(nnue_output_weights,  sizeof(nnue_output_weights),  1, file) == 1 &&
+               fread(&nnue_output_bias,    sizeof(nnue_output_bias),     1, file) == 1 &&
+               fgetc(file) == EOF;                                                                                     // make sure the network has the expected size
+  fclose(file);
+
+  nnue_loaded = loaded;
+  if (nnue_loaded) nnue_refresh();
+  return loaded;
+}
+
+// Move generator
+
+#define force_inline static inline __attribute__((always_inline))                                                      /* instantiate a function body per call site */
+
+// is square current given attacked by the current given side (inlined per side where the side is known)
+force_inline int
+is_square_attacked_by(Square square, const int side)
 {
   if ((side == WHITE) && (pawn_attacks[BLACK][square] & bitboards[P]))                                 return 1;       // attacked by white pawns
   if ((side == BLACK) && (pawn_attacks[WHITE][square] & bitboards[p]))                                 return 1;       // attacked by black pawns
@@ -876,6 +1138,13 @@ is_square_attacked(Square square, int side)
   return 0;                                                                                                            // by default return false
 }
 
+// is square current given attacked by the current given side
+int
+is_square_attacked(Square square, int side)
+{
+  return (side == WHITE) ? is_square_attacked_by(square, WHITE) : is_square_attacked_by(square, BLACK);
+}
+
 // print attacked squares
 void
 print_attacked_squares(int side)
@@ -919,6 +1188,17 @@ print_attacked_squares(int side)
 #define get_move_enpassant(move)  (move & 0x400000)                                                                    /* extract enpassant flag */
 #define get_move_castling(move)   (move & 0x800000)                                                                    /* extract castling flag */
 
+//    compact 16-bit move (TT, PV, killers, counter moves)
+//
+//    0000 0000 0011 1111    source square       0x3f
+//    0000 1111 1100 0000    target square       0xfc0
+//    1111 0000 0000 0000    promoted piece      0xf000
+
+typedef unsigned short CompactMove;
+
+#define compact_move(move)        (CompactMove)(((move) & 0xfff) | (((move) & 0xf0000) >> 4))                          /* compact a move (drops piece & flags) */
+#define expand_move(move)         ((((move) & 0xf000) << 4) | ((move) & 0xfff))                                        /* source, target & promoted piece of a compact move */
+
 // move list structure
 typedef struct
 {
@@ -934,6 +1214,15 @@ add_move(moves* move_list, int move)
   move_list->count++;                                                                                                  // increment move count
 }
 
+// write move in UCI notation into a buffer of at least 6 chars ("0000" for no move)
+void
+move_to_string(int move, char* buffer)
+{
+  if (move == 0) strcpy(buffer, "0000");
+  else           sprintf(buffer, "%s%s", square_to_coordinates[get_move_source(move)], square_to_coordinates[get_move_target(move)]);
+  if (get_move_promoted(move)) buffer[4] = promoted_pieces[get_move_promoted(move)], buffer[5] = 0;
+}
+
 // print move (for UCI purposes)
 void
 print_move(int move)
@@ -974,21 +1263,46 @@ print_move_list(moves* move_list)
   printf("\n\n     Total number of moves: %d\n\n", move_list->count);                                                  // print total number of moves
 }
 
+// board state changed by make_move (undo record)
+typedef struct
+{
+  U64 bitboards[12];                                                                                                   // piece bitboards
+  U64 occupancies[3];                                                                                                  // occupancy bitboards
+  U64 hash_key;                                                                                                        // hash key
+  U64 material_key;                                                                                                    // material key
+  int side;                                                                                                            // side to move
+  int enpassant;                                                                                                       // enpassant square
+  int castle;                                                                                                          // castling rights
+  int fifty;                                                                                                           // fifty move rule counter
+  int nnue_ply;                                                                                                        // NNUE accumulator of the position
+} board_state;
+
+// preserve board state into an undo record
+#define save_board(state)                                                      \
+  memcpy((state)->bitboards, bitboards, 96);                                   \
+  memcpy((state)->occupancies, occupancies, 24);                               \
+  (state)->side = side, (state)->enpassant = enpassant;                        \
+  (state)->castle = castle, (state)->fifty = fifty;                            \
+  (state)->hash_key = hash_key, (state)->nnue_ply = nnue_ply;                  \
+  (state)->material_key = material_key;
+
+// restore board state from an undo record
+#define restore_board(state)                                                   \
+  memcpy(bitboards, (state)->bitboards, 96);                                   \
+  memcpy(occupancies, (state)->occupancies, 24);                               \
+  side = (state)->side, enpassant = (state)->enpassant;                        \
+  castle = (state)->castle, fifty = (state)->fifty;                            \
+  hash_key = (state)->hash_key, nnue_ply = (state)->nnue_ply;                  \
+  material_key = (state)->material_key;
+
 // preserve board state
 #define copy_board()                                                           \
-  U64 bitboards_copy[12], occupancies_copy[3];                                 \
-  int side_copy, enpassant_copy, castle_copy;                                  \
-  memcpy(bitboards_copy, bitboards, 96);                                       \
-  memcpy(occupancies_copy, occupancies, 24);                                   \
-  side_copy = side, enpassant_copy = enpassant, castle_copy = castle;          \
-  U64 hash_key_copy = hash_key;
+  board_state board_copy;                                                      \
+  save_board(&board_copy);
 
 // restore board state
 #define take_back()                                                            \
-  memcpy(bitboards, bitboards_copy, 96);                                       \
-  memcpy(occupancies, occupancies_copy, 24);                                   \
-  side = side_copy, enpassant = enpassant_copy, castle = castle_copy;          \
-  hash_key = hash_key_copy;
+  restore_board(&board_copy);
 
 // move types
 enum
@@ -1018,9 +1332,9 @@ const int castling_rights[64] = {  7, 15, 15, 15,  3, 15, 15, 11,
                                   15, 15, 15, 15, 15, 15, 15, 15,
                                   13, 15, 15, 15, 12, 15, 15, 14 };
 
-// make move on chess board
-int
-make_move(int move, int move_flag)
+// make move on chess board for one side (inlined with "us" as a compile-time constant)
+force_inline int
+make_side_move(int move, int move_flag, const int us)
 {
   if (move_flag == all_moves) {                                                                                        // quiet moves
     copy_board();                                                                                                      // preserve board state
@@ -1033,6 +1347,7 @@ make_move(int move, int move_flag)
     int double_push    = get_move_double(move);
     int enpass         = get_move_enpassant(move);
     int castling       = get_move_castling(move);
+    int victim         = -1;                                                                                           // captured piece (-1 if none)
 
     pop_bit(bitboards[piece], source_square);                                                                          // move piece
     set_bit(bitboards[piece], target_square);
@@ -1040,10 +1355,13 @@ make_move(int move, int move_flag)
     hash_key ^= piece_keys[piece][source_square];                                                                      // remove piece from source square in hash key
     hash_key ^= piece_keys[piece][target_square];                                                                      // set piece to the target square in hash key
 
+    fifty++;                                                                                                           // increment fifty move rule counter
+    if (capture || piece == P || piece == p) fifty = 0;                                                                // reset it on irreversible moves
+
     if (capture) {                                                                                                     // handling capture moves
       int start_piece, end_piece;                                                                                      // pick up bitboard piece index ranges depending on side
 
-      if (side == WHITE) {                                                                                             // white to move
+      if (us == WHITE) {                                                                                               // white to move
         start_piece = p;
         end_piece = k;
       }
@@ -1054,15 +1372,17 @@ make_move(int move, int move_flag)
 
       for (int bb_piece = start_piece; bb_piece <= end_piece; bb_piece++) {                                            // loop over bitboards opposite to the current side to move
         if (get_bit(bitboards[bb_piece], target_square)) {                                                             // if there's a piece on the target square
+          victim = bb_piece;
           pop_bit(bitboards[bb_piece], target_square);                                                                 // remove it from corresponding bitboard
           hash_key ^= piece_keys[bb_piece][target_square];                                                             // remove the piece from hash key
+          material_key -= material_keys[bb_piece];                                                                     // and from material key
           break;
         }
       }
     }
 
     if (promoted_piece) {                                                                                              // handle pawn promotions
-      if (side == WHITE) {                                                                                             // white to move
+      if (us == WHITE) {                                                                                               // white to move
         pop_bit(bitboards[P], target_square);                                                                          // erase the pawn from the target square
         hash_key ^= piece_keys[P][target_square];                                                                      // remove pawn from hash key
       }
@@ -1072,18 +1392,21 @@ make_move(int move, int move_flag)
       }
       set_bit(bitboards[promoted_piece], target_square);                                                               // set up promoted piece on chess board
       hash_key ^= piece_keys[promoted_piece][target_square];                                                           // add promoted piece into the hash key
+      material_key += material_keys[promoted_piece] - material_keys[(us == WHITE) ? P : p];                            // pawn turns into promoted piece
     }
 
     if (enpass) {                                                                                                      // handle enpassant captures
-      (side == WHITE) ? pop_bit(bitboards[p], target_square + 8)                                                       // erase the pawn depending on side to move
+      (us == WHITE) ? pop_bit(bitboards[p], target_square + 8)                                                         // erase the pawn depending on side to move
                       : pop_bit(bitboards[P], target_square - 8);
-      if (side == WHITE) {                                                                                             // white to move
+      if (us == WHITE) {                                                                                               // white to move
         pop_bit(bitboards[p], target_square + 8);                                                                      // remove captured pawn
         hash_key ^= piece_keys[p][target_square + 8];                                                                  // remove pawn from hash key
+        material_key -= material_keys[p];
       }
       else {                                                                                                           // black to move
         pop_bit(bitboards[P], target_square - 8);                                                                      // remove captured pawn
         hash_key ^= piece_keys[P][target_square - 8];                                                                  // remove pawn from hash key
+        material_key -= material_keys[P];
       }
     }
 
@@ -1092,7 +1415,7 @@ make_move(int move, int move_flag)
     enpassant = no_sq;                                                                                                 // reset enpassant square
 
     if (double_push) {                                                                                                 // handle double pawn push
-      if (side == WHITE) {                                                                                             // white to move
+      if (us == WHITE) {                                                                                               // white to move
         enpassant = target_square + 8;                                                                                 // set enpassant square
         hash_key ^= enpassant_keys[target_square + 8];                                                                 // hash enpassant
       }
@@ -1152,294 +1475,248 @@ make_move(int move, int move_flag)
     side ^= 1;                                                                                                         // change side
     hash_key ^= side_key;                                                                                              // hash side
 
-    if (is_square_attacked((side == WHITE) ? get_ls1b_index(bitboards[k])                                              // make sure that king has not been exposed into a check
-                                           : get_ls1b_index(bitboards[K]), side)) {
+    if (is_square_attacked_by((us == WHITE) ? get_ls1b_index(bitboards[K])                                             // make sure that king has not been exposed into a check
+                                           : get_ls1b_index(bitboards[k]), us ^ 1)) {
       take_back();                                                                                                     // take move back
       return 0;                                                                                                        // return illegal move
     }
-    else
-      return 1;                                                                                                        // return legal move
-  }
-  else {                                                                                                               // capture moves
-    if    (get_move_capture(move))  make_move(move, all_moves);                                                        // make sure move is the capture
-    else                            return 0;                                                                          // don't make it otherwise; the move is not a capture
-  }
-}                                                                                                                      // ????
-
-// generate all moves
-void
-generate_moves(moves* move_list)
-{
-  move_list->count = 0;                                                                                                // init move count
-  int source_square, target_square;
-
-  U64 bitboard, attacks;                                                                                               // define current piece's bitboard copy & it's attacks
-
-  for (int piece = P; piece <= k; piece++) {                                                                           // loop over all the bitboards
-    bitboard = bitboards[piece];                                                                                       // init piece bitboard copy
-
-    if (side == WHITE) {                                                                                               // generate white pawns & white king castling moves
-      if (piece == P) {                                                                                                // pick up white pawn bitboards index
-        while (bitboard) {                                                                                             // loop over white pawns within white pawn bitboard
-          source_square = get_ls1b_index(bitboard);                                                                    // init source square
-          target_square = source_square - 8;                                                                           // init target square
-          if (!(target_square < a8) &&                                                                                 // generate quiet pawn moves
-              !get_bit(occupancies[BOTH], target_square)) {
-            if (source_square >= a7 && source_square <= h7) {                                                          // pawn promotion
-              add_move(move_list, encode_move( source_square, target_square, piece, Q, 0, 0, 0, 0));
-              add_move(move_list, encode_move( source_square, target_square, piece, R, 0, 0, 0, 0));
-              add_move(move_list, encode_move( source_square, target_square, piece, B, 0, 0, 0, 0));
-              add_move(move_list, encode_move( source_square, target_square, piece, N, 0, 0, 0, 0));
-            }
-            else {
-              add_move(move_list, encode_move( source_square, target_square, piece, 0, 0, 0, 0, 0));                   // one square ahead pawn move
-              if ((source_square >= a2 && source_square <= h2) &&                                                      // two squares ahead pawn move
-                  !get_bit(occupancies[BOTH], target_square - 8))
-                add_move( move_list, encode_move( source_square, target_square - 8, piece, 0, 0, 1, 0, 0));            // ?????
-            }
-          }
-
-          attacks = pawn_attacks[side][source_square] & occupancies[BLACK];                                            // init pawn attacks bitboard
-
-          while (attacks) {                                                                                            // generate pawn captures
-            target_square = get_ls1b_index(attacks);                                                                   // init target square
-
-            if (source_square >= a7 && source_square <= h7) {                                                          // pawn promotion
-              add_move(move_list, encode_move( source_square, target_square, piece, Q, 1, 0, 0, 0));
-              add_move(move_list, encode_move( source_square, target_square, piece, R, 1, 0, 0, 0));
-              add_move(move_list, encode_move( source_square, target_square, piece, B, 1, 0, 0, 0));
-              add_move(move_list, encode_move( source_square, target_square, piece, N, 1, 0, 0, 0));
-            }
-            else
-              add_move(move_list, encode_move( source_square, target_square, piece, 0, 1, 0, 0, 0));                   // one square ahead pawn move
-
-            pop_bit(attacks, target_square);                                                                           // pop ls1b of the pawn attacks
-          }
-
-          if (enpassant != no_sq) {                                                                                    // generate enpassant captures
-            U64 enpassant_attacks = pawn_attacks[side][source_square] & (1ULL << enpassant);                           // lookup pawn attacks and bitwise AND with enpassant square (bit)
-
-            if (enpassant_attacks) {                                                                                   // make sure enpassant capture available
-              int target_enpassant = get_ls1b_index(enpassant_attacks);                                                // init enpassant capture target square
-              add_move( move_list, encode_move( source_square, target_enpassant, piece, 0, 1, 0, 1, 0));
-            }
-          }
-
-          pop_bit(bitboard, source_square);                                                                            // pop ls1b from piece bitboard copy
-        }
-      }
 
-      if (piece == K) {                                                                                                // castling moves
-        if (castle & WK) {                                                                                             // king side castling is available
-          if (!get_bit(occupancies[BOTH], f1) &&                                                                       // make sure square between king and king's rook are empty
-              !get_bit(occupancies[BOTH], g1)) {
-            if (!is_square_attacked(e1, BLACK) &&                                                                      // make sure king and the f1 squares are not under attacks
-                !is_square_attacked(f1, BLACK))
-              add_move(move_list, encode_move(e1, g1, piece, 0, 0, 0, 0, 1));
-          }
-        }
+    if (use_nnue) {                                                                                                    // update NNUE accumulator
+      int pawn         = (us == WHITE) ? p : P;                                                                        // enemy pawn (enpassant victim)
+      int rook         = (us == WHITE) ? R : r;                                                                        // our rook (castling)
+      int added[4]     = { promoted_piece ? promoted_piece : piece, target_square };                                   // [piece, square] pairs
+      int removed[4]   = { piece, source_square };
+      int added_count  = 1, removed_count = 1;
 
-        if (castle & WQ) {                                                                                             // queen side castling is available
-          if (!get_bit(occupancies[BOTH], d1) &&                                                                       // make sure square between king and queen's rook are empty
-              !get_bit(occupancies[BOTH], c1) &&
-              !get_bit(occupancies[BOTH], b1)) {
-            if (!is_square_attacked(e1, BLACK) &&                                                                      // make sure king and the d1 squares are not under attacks
-                !is_square_attacked(d1, BLACK))
-              add_move(move_list, encode_move(e1, c1, piece, 0, 0, 0, 0, 1));
-          }
-        }
+      if (victim != -1) {                                                                                              // captured piece
+        removed[2] = victim, removed[3] = target_square;
+        removed_count++;
       }
-    }
-    else {                                                                                                             // generate black pawns & black king castling moves
-      if (piece == p) {                                                                                                // pick up black pawn bitboards index
-        while (bitboard) {                                                                                             // loop over white pawns within white pawn bitboard
-          source_square = get_ls1b_index(bitboard);                                                                    // init source square
-
-          target_square = source_square + 8;                                                                           // init target square
-
-          if (!(target_square > h1) &&                                                                                 // generate quiet pawn moves
-              !get_bit(occupancies[BOTH], target_square)) {
-            if (source_square >= a2 && source_square <= h2) {                                                          // pawn promotion
-              add_move(move_list, encode_move( source_square, target_square, piece, q, 0, 0, 0, 0));
-              add_move(move_list, encode_move( source_square, target_square, piece, r, 0, 0, 0, 0));
-              add_move(move_list, encode_move( source_square, target_square, piece, b, 0, 0, 0, 0));
-              add_move(move_list, encode_move( source_square, target_square, piece, n, 0, 0, 0, 0));
-            }
-            else {
-              add_move(move_list, encode_move( source_square, target_square, piece, 0, 0, 0, 0, 0));                   // one square ahead pawn move
-
-              if ((source_square >= a7 && source_square <= h7) &&                                                      // two squares ahead pawn move
-                  !get_bit(occupancies[BOTH], target_square + 8))
-                add_move(move_list, encode_move( source_square, target_square + 8, piece, 0, 0, 1, 0, 0));             // ????
-            }
-          }
-
-          attacks = pawn_attacks[side][source_square] & occupancies[WHITE];                                            // init pawn attacks bitboard
-
-          while (attacks) {                                                                                            // generate pawn captures
-            target_square = get_ls1b_index(attacks);                                                                   // init target square
-
-            if (source_square >= a2 && source_square <= h2) {                                                          // pawn promotion
-              add_move(move_list, encode_move( source_square, target_square, piece, q, 1, 0, 0, 0));
-              add_move(move_list, encode_move( source_square, target_square, piece, r, 1, 0, 0, 0));
-              add_move(move_list, encode_move( source_square, target_square, piece, b, 1, 0, 0, 0));
-              add_move(move_list, encode_move( source_square, target_square, piece, n, 1, 0, 0, 0));
-            }
-            else
-              add_move(move_list, encode_move( source_square, target_square, piece, 0, 1, 0, 0, 0));                   // one square ahead pawn move
-
-            pop_bit(attacks, target_square);                                                                           // pop ls1b of the pawn attacks
-          }
-
-          if (enpassant != no_sq) {                                                                                    // generate enpassant captures
-            U64 enpassant_attacks = pawn_attacks[side][source_square] & (1ULL << enpassant);                           // lookup pawn attacks and bitwise AND with enpassant square (bit)
-
-            if (enpassant_attacks) {                                                                                   // make sure enpassant capture available
-              int target_enpassant = get_ls1b_index(enpassant_attacks);                                                // init enpassant capture target square
-              add_move(move_list, encode_move( source_square, target_enpassant, piece, 0, 1, 0, 1, 0));
-            }
-          }
-
-          pop_bit(bitboard, source_square);                                                                            // pop ls1b from piece bitboard copy
-        }
+      if (enpass) {                                                                                                    // captured enpassant pawn
+        removed[2] = pawn, removed[3] = (us == WHITE) ? target_square + 8 : target_square - 8;
+        removed_count++;
       }
-
-      if (piece == k) {                                                                                                // castling moves
-        if (castle & BK) {                                                                                             // king side castling is available
-          if (!get_bit(occupancies[BOTH], f8) &&                                                                       // make sure square between king and king's rook are empty
-              !get_bit(occupancies[BOTH], g8)) {
-            if (!is_square_attacked(e8, WHITE) &&                                                                      // make sure king and the f8 squares are not under attacks
-                !is_square_attacked(f8, WHITE))
-              add_move(move_list, encode_move(e8, g8, piece, 0, 0, 0, 0, 1));
-          }
-        }
-
-        if (castle & BQ) {                                                                                             // queen side castling is available
-          if (!get_bit(occupancies[BOTH], d8) &&                                                                       // make sure square between king and queen's rook are empty
-              !get_bit(occupancies[BOTH], c8) &&
-              !get_bit(occupancies[BOTH], b8)) {
-            if (!is_square_attacked(e8, WHITE) &&                                                                      // make sure king and the d8 squares are not under attacks
-                !is_square_attacked(d8, WHITE))
-              add_move(move_list, encode_move(e8, c8, piece, 0, 0, 0, 0, 1));
-          }
-        }
+      if (castling) {                                                                                                  // castled rook
+        int king_side = target_square > source_square;
+        added[2]   = rook, added[3]   = king_side ? target_square - 1 : target_square + 1;                             // f1/d1 or f8/d8
+        removed[2] = rook, removed[3] = king_side ? target_square + 1 : target_square - 2;                             // h1/a1 or h8/a8
+        added_count++, removed_count++;
       }
+      nnue_make_move(added, added_count, removed, removed_count);
     }
+    return 1;                                                                                                          // return legal move
+  }
+  else {                                                                                                               // capture moves
+    if    (get_move_capture(move))  return make_side_move(move, all_moves, us);                                        // make sure move is the capture
+    else                            return 0;                                                                          // don't make it otherwise; the move is not a capture
+  }
+}
 
-    if ((side == WHITE) ? piece == N : piece == n) {                                                                   // genarate knight moves
-      while (bitboard) {                                                                                               // loop over source squares of piece bitboard copy
-        source_square = get_ls1b_index(bitboard);                                                                      // init source square
-
-        attacks = knight_attacks[source_square] &                                                                      // init piece attacks in order to get set of target squares
-                  ((side == WHITE) ? ~occupancies[WHITE] : ~occupancies[BLACK]);
+// make move on chess board
+int
+make_move(int move, int move_flag)
+{
+  if (side == WHITE) return make_side_move(move, move_flag, WHITE);                                                    // one specialized version per side
+  else               return make_side_move(move, move_flag, BLACK);
+}
 
-        while (attacks) {                                                                                              // loop over target squares available from generated attacks
-          target_square = get_ls1b_index(attacks);                                                                     // init target square
+typedef struct                                                                                                         // check detection data of a position
+{
+  Bitboard check_squares[12];                                                                                          // squares from which a piece of the side to move checks the enemy king [piece]
+  Bitboard discovered_candidates;                                                                                      // pieces of the side to move shielding the enemy king from own sliders
+  Square   king_square;                                                                                                // enemy king square
+} check_info;
 
-          if (!get_bit(((side == WHITE) ? occupancies[BLACK] : occupancies[WHITE]), target_square))                    // quiet move
-            add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
+// init check squares & discovered check candidates for the side to move
+void
+init_check_info(check_info* info)
+{
+  int      us          = (side == WHITE) ? P : p;                                                                      // first piece of the side to move (us + N is our knight etc.)
+  Square   king_square = get_ls1b_index(bitboards[(side == WHITE) ? k : K]);                                           // enemy king square
+  Bitboard bishops     = bitboards[us + B] | bitboards[us + Q];                                                        // diagonal sliders of the side to move
+  Bitboard rooks       = bitboards[us + R]   | bitboards[us + Q];                                                      // straight sliders of the side to move
+
+  memset(info->check_squares, 0, sizeof(info->check_squares));
+  info->king_square                     = king_square;
+  info->check_squares[us]               = pawn_attacks[side ^ 1][king_square];                                         // a pawn checks from where an enemy pawn would attack
+  info->check_squares[us + N]           = knight_attacks[king_square];
+  info->check_squares[us + B]           = get_bishop_attacks(king_square, occupancies[BOTH]);
+  info->check_squares[us + R]           = get_rook_attacks(king_square, occupancies[BOTH]);
+  info->check_squares[us + Q]           = info->check_squares[us + B] | info->check_squares[us + R];
+
+  info->discovered_candidates = 0ULL;
+  Bitboard snipers = (get_bishop_attacks(king_square, 0ULL) & bishops) |                                               // sliders aiming at the king through any pieces
+                     (get_rook_attacks(king_square, 0ULL)   & rooks);
+  while (snipers) {
+    Square   sniper   = get_ls1b_index(snipers);
+    Bitboard blockers = between_squares[king_square][sniper] & occupancies[BOTH];
+    if (blockers && (blockers & (blockers - 1)) == 0 && (blockers & occupancies[side]))                                // exactly one blocker and it's our own piece
+      info->discovered_candidates |= blockers;
+    pop_bit(snipers, sniper);
+  }
+}
 
-          else
-            add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));                      // capture move
+// does the (pseudo legal) move of the side to move give check
+int
+gives_check(int move, check_info* info)
+{
+  Square   source_square = get_move_source(move);
+  Square   target_square = get_move_target(move);
+  int      piece         = get_move_piece(move);
+  int      promoted      = get_move_promoted(move);
+  int      us            = (side == WHITE) ? P : p;                                                                    // first piece of the side to move
+  Square   king_square   = info->king_square;
+  Bitboard king          = 1ULL << king_square;
+
+  if (promoted) {                                                                                                      // promoted piece attacks through the vacated source square
+    Bitboard occupancy = (occupancies[BOTH] ^ (1ULL << source_square)) | (1ULL << target_square);
+    Bitboard attacks   = 0ULL;
+    if      (promoted == us + N) attacks = knight_attacks[target_square];
+    else if (promoted == us + B) attacks = get_bishop_attacks(target_square, occupancy);
+    else if (promoted == us + R) attacks = get_rook_attacks(target_square, occupancy);
+    else                         attacks = get_queen_attacks(target_square, occupancy);
+    if (attacks & king) return 1;
+  }
+  else if (info->check_squares[piece] & (1ULL << target_square))                                                       // direct check
+    return 1;
+
+  if ((info->discovered_candidates & (1ULL << source_square)) &&                                                       // discovered check unless the piece stays on the line
+      (between_squares[king_square][target_square] & (1ULL << source_square)) == 0 &&
+      (between_squares[king_square][source_square] & (1ULL << target_square)) == 0)
+    return 1;
+
+  if (get_move_enpassant(move)) {                                                                                      // captured pawn may uncover a slider
+    Square   captured  = (side == WHITE) ? target_square + 8 : target_square - 8;
+    Bitboard occupancy = (occupancies[BOTH] ^ (1ULL << source_square) ^ (1ULL << captured)) | (1ULL << target_square);
+    return (get_bishop_attacks(king_square, occupancy) & (bitboards[us + B] | bitboards[us + Q])) ||
+           (get_rook_attacks(king_square, occupancy)   & (bitboards[us + R]   | bitboards[us + Q]));
+  }
 
-          pop_bit(attacks, target_square);                                                                             // pop ls1b in current attacks set
-        }
+  if (get_move_castling(move)) {                                                                                       // castled rook may give check
+    Square   rook_square = (target_square > source_square) ? target_square - 1 : target_square + 1;                    // f1/d1 or f8/d8
+    Square   rook_source = (target_square > source_square) ? target_square + 1 : target_square - 2;                    // h1/a1 or h8/a8
+    Bitboard occupancy   = occupancies[BOTH] ^ (1ULL << source_square) ^ (1ULL << target_square) ^
+                           (1ULL << rook_source) ^ (1ULL << rook_square);
+    return (get_rook_attacks(rook_square, occupancy) & king) != 0;
+  }
 
-        pop_bit(bitboard, source_square);                                                                              // pop ls1b of the current piece bitboard copy
-      }
-    }
+  return 0;
+}
 
-    if ((side == WHITE) ? piece == B : piece == b) {                                                                   // generate bishop moves
-      while (bitboard) {                                                                                               // loop over source squares of piece bitboard copy
-        source_square = get_ls1b_index(bitboard);                                                                      // init source square
+// generate all moves of one side (inlined with "us" as a compile-time constant, so piece indices,
+// pawn directions & ranks fold into constants)
+force_inline void
+generate_side_moves(moves* move_list, const int us)
+{
+  const int them      = us ^ 1;                                                                                        // opponent
+  const int pawn      = (us == WHITE) ? P : p;                                                                         // our pieces
+  const int knight    = (us == WHITE) ? N : n;
+  const int bishop    = (us == WHITE) ? B : b;
+  const int rook      = (us == WHITE) ? R : r;
+  const int queen     = (us == WHITE) ? Q : q;
+  const int king      = (us == WHITE) ? K : k;
+  const int push      = (us == WHITE) ? -8 : 8;                                                                        // pawn push offset
+  const U64 seventh   = (us == WHITE) ? 0x000000000000ff00ULL : 0x00ff000000000000ULL;                                 // pawns promoting with the next move
+  const U64 second    = (us == WHITE) ? 0x00ff000000000000ULL : 0x000000000000ff00ULL;                                 // pawns allowed to double push
+  const U64 empty     = ~occupancies[BOTH];
+  const U64 enemies   = occupancies[them];
+  const U64 available = ~occupancies[us];                                                                              // empty or enemy squares
 
-        attacks = get_bishop_attacks(source_square, occupancies[BOTH]) &                                               // init piece attacks in order to get set of target squares
-                  ((side == WHITE) ? ~occupancies[WHITE] : ~occupancies[BLACK]);
+  int source_square, target_square;
+  U64 bitboard, attacks;
 
-        while (attacks) {                                                                                              // loop over target squares available from generated attacks
-          target_square = get_ls1b_index(attacks);                                                                     // init target square
+  move_list->count = 0;                                                                                                // init move count
 
-          if (!get_bit(((side == WHITE) ? occupancies[BLACK] : occupancies[WHITE]), target_square))                    // quiet move
-            add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
-          else
-            add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));                      // capture move
-          pop_bit(attacks, target_square);                                                                             // pop ls1b in current attacks set
-        }
-        pop_bit(bitboard, source_square);                                                                              // pop ls1b of the current piece bitboard copy
+  bitboard = bitboards[pawn];                                                                                          // generate pawn moves
+  while (bitboard) {
+    source_square = get_ls1b_index(bitboard);                                                                          // init source square
+    target_square = source_square + push;                                                                              // init target square
+    U64 source    = 1ULL << source_square;
+
+    if (get_bit(empty, target_square)) {                                                                               // generate quiet pawn moves
+      if (source & seventh) {                                                                                          // pawn promotion
+        add_move(move_list, encode_move(source_square, target_square, pawn, queen,  0, 0, 0, 0));
+        add_move(move_list, encode_move(source_square, target_square, pawn, rook,   0, 0, 0, 0));
+        add_move(move_list, encode_move(source_square, target_square, pawn, bishop, 0, 0, 0, 0));
+        add_move(move_list, encode_move(source_square, target_square, pawn, knight, 0, 0, 0, 0));
       }
-    }
-
-    if ((side == WHITE) ? piece == R : piece == r) {                                                                   // generate rook moves
-      while (bitboard) {                                                                                               // loop over source squares of piece bitboard copy
-        source_square = get_ls1b_index(bitboard);                                                                      // init source square
-
-        attacks = get_rook_attacks(source_square, occupancies[BOTH]) &                                                 // init piece attacks in order to get set of target squares
-                  ((side == WHITE) ? ~occupancies[WHITE] : ~occupancies[BLACK]);
-
-        while (attacks) {                                                                                              // loop over target squares available from generated attacks
-          target_square = get_ls1b_index(attacks);                                                                     // init target square
-
-          if (!get_bit(((side == WHITE) ? occupancies[BLACK] : occupancies[WHITE]), target_square))                    // quiet move
-            add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
-          else
-            add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));                      // capture move
-
-          pop_bit(attacks, target_square);                                                                             // pop ls1b in current attacks set
-        }
-
-        pop_bit(bitboard, source_square);                                                                              // pop ls1b of the current piece bitboard copy
+      else {
+        add_move(move_list, encode_move(source_square, target_square, pawn, 0, 0, 0, 0, 0));                           // one square ahead pawn move
+        if ((source & second) && get_bit(empty, target_square + push))                                                 // two squares ahead pawn move
+          add_move(move_list, encode_move(source_square, (target_square + push), pawn, 0, 0, 1, 0, 0));
       }
     }
 
-    if ((side == WHITE) ? piece == Q : piece == q) {                                                                   // generate queen moves
-      while (bitboard) {                                                                                               // loop over source squares of piece bitboard copy
-        source_square = get_ls1b_index(bitboard);                                                                      // init source square
-
-        attacks = get_queen_attacks(source_square, occupancies[BOTH]) &                                                // init piece attacks in order to get set of target squares
-                  ((side == WHITE) ? ~occupancies[WHITE] : ~occupancies[BLACK]);
-
-        while (attacks) {                                                                                              // loop over target squares available from generated attacks
-          target_square = get_ls1b_index(attacks);                                                                     // init target square
-
-          if (!get_bit(((side == WHITE) ? occupancies[BLACK] : occupancies[WHITE]), target_square))                    // quiet move
-            add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
-          else
-            add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));                      // capture move
-          pop_bit(attacks, target_square);                                                                             // pop ls1b in current attacks set
-        }
-
-        pop_bit(bitboard, source_square);                                                                              // pop ls1b of the current piece bitboard copy
+    attacks = pawn_attacks[us][source_square] & enemies;                                                               // generate pawn captures
+    while (attacks) {
+      target_square = get_ls1b_index(attacks);                                                                         // init target square
+      if (source & seventh) {                                                                                          // pawn promotion
+        add_move(move_list, encode_move(source_square, target_square, pawn, queen,  1, 0, 0, 0));
+        add_move(move_list, encode_move(source_square, target_square, pawn, rook,   1, 0, 0, 0));
+        add_move(move_list, encode_move(source_square, target_square, pawn, bishop, 1, 0, 0, 0));
+        add_move(move_list, encode_move(source_square, target_square, pawn, knight, 1, 0, 0, 0));
       }
+      else
+        add_move(move_list, encode_move(source_square, target_square, pawn, 0, 1, 0, 0, 0));
+      pop_bit(attacks, target_square);                                                                                 // pop ls1b of the pawn attacks
     }
 
-    if ((side == WHITE) ? piece == K : piece == k) {                                                                   // generate king moves
-      while (bitboard) {                                                                                               // loop over source squares of piece bitboard copy
-        source_square = get_ls1b_index(bitboard);                                                                      // init source square
-
-        attacks = king_attacks[source_square] &                                                                        // init piece attacks in order to get set of target squares
-                  ((side == WHITE) ? ~occupancies[WHITE] : ~occupancies[BLACK]);
+    if (enpassant != no_sq && (pawn_attacks[us][source_square] & (1ULL << enpassant)))                                 // generate enpassant captures
+      add_move(move_list, encode_move(source_square, enpassant, pawn, 0, 1, 0, 1, 0));
 
-        while (attacks) {                                                                                              // loop over target squares available from generated attacks
-          target_square = get_ls1b_index(attacks);                                                                     // init target square
-
-          if (!get_bit(((side == WHITE) ? occupancies[BLACK] : occupancies[WHITE]), target_square))                    // quiet move
-            add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
-          else
-            add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));                      // capture move
+    pop_bit(bitboard, source_square);                                                                                  // pop ls1b from piece bitboard
+  }
 
-          pop_bit(attacks, target_square);                                                                             // pop ls1b in current attacks set
-        }
+  for (int piece = knight; piece <= king; piece++) {                                                                   // generate piece moves
+    if (piece == king) {                                                                                               // castling moves
+      const int king_side  = (us == WHITE) ? WK : BK;                                                                  // castling rights & squares of our side
+      const int queen_side = (us == WHITE) ? WQ : BQ;
+      const int e_square   = (us == WHITE) ? e1 : e8;
+
+      if ((castle & king_side) &&                                                                                      // king side castling is available
+          !get_bit(occupancies[BOTH], e_square + 1) && !get_bit(occupancies[BOTH], e_square + 2) &&                    // squares between king & rook are empty
+          !is_square_attacked_by(e_square, them) && !is_square_attacked_by(e_square + 1, them))                        // king & the square it passes are not attacked
+        add_move(move_list, encode_move(e_square, (e_square + 2), king, 0, 0, 0, 0, 1));
+
+      if ((castle & queen_side) &&                                                                                     // queen side castling is available
+          !get_bit(occupancies[BOTH], e_square - 1) && !get_bit(occupancies[BOTH], e_square - 2) &&                    // squares between king & rook are empty
+          !get_bit(occupancies[BOTH], e_square - 3) &&
+          !is_square_attacked_by(e_square, them) && !is_square_attacked_by(e_square - 1, them))                        // king & the square it passes are not attacked
+        add_move(move_list, encode_move(e_square, (e_square - 2), king, 0, 0, 0, 0, 1));
+    }
 
-        pop_bit(bitboard, source_square);                                                                              // pop ls1b of the current piece bitboard copy
+    bitboard = bitboards[piece];
+    while (bitboard) {                                                                                                 // loop over source squares of piece bitboard copy
+      source_square = get_ls1b_index(bitboard);                                                                        // init source square
+
+      if      (piece == knight) attacks = knight_attacks[source_square];                                               // init piece attacks
+      else if (piece == bishop) attacks = get_bishop_attacks(source_square, occupancies[BOTH]);
+      else if (piece == rook)   attacks = get_rook_attacks(source_square, occupancies[BOTH]);
+      else if (piece == queen)  attacks = get_queen_attacks(source_square, occupancies[BOTH]);
+      else                      attacks = king_attacks[source_square];
+      attacks &= available;                                                                                            // in order to get only empty or enemy squares
+
+      while (attacks) {                                                                                                // loop over target squares available from generated attacks
+        target_square = get_ls1b_index(attacks);                                                                       // init target square
+        int capture   = get_bit(enemies, target_square) ? 1 : 0;                                                       // quiet move or capture
+        add_move(move_list, encode_move(source_square, target_square, piece, 0, capture, 0, 0, 0));
+        pop_bit(attacks, target_square);                                                                               // pop ls1b in current attacks set
       }
+
+      pop_bit(bitboard, source_square);                                                                                // pop ls1b of the current piece bitboard copy
     }
   }
 }
 
-// Perft
+// generate all moves
+void
+generate_moves(moves* move_list)
+{
+  if (side == WHITE) generate_side_moves(move_list, WHITE);                                                            // one specialized generator per side
+  else               generate_side_moves(move_list, BLACK);
+}
 
-// leaf nodes (number of positions reached during the test of the move generator at a given depth)
-U64 nodes;
+// Perft
 
 // perft driver
 void
@@ -1696,89 +1973,327 @@ init_evaluation_masks()
   }
 }
 
-// position evaluation
+// KPK bitbase
+
+// Win/draw table of every king & pawn vs king position, computed at startup by retrograde analysis: starting from
+// the positions decided at once (safe promotions, stalemates, lost pawns) the others are classified from their
+// successors until nothing changes anymore. Positions are normalized to a white pawn on files a-d.
+
+#define kpk_size (2 * 64 * 64 * 24)                                                                                    /* positions [pawn rank & file][white king][black king][side] */
+
+enum { kpk_invalid = 0, kpk_unknown = 1, kpk_draw = 2, kpk_win = 4 };                                                  // position results (invalid positions never count)
+
+unsigned int kpk_bitbase[kpk_size / 32];                                                                               // 1 bit per position: white wins (24 KB)
+
+// index of a normalized KPK position (pawn on files a-d & ranks 2-7)
 int
-evaluate()
+kpk_index(int stm, int black_king, int white_king, int pawn)
 {
-  int score = 0;                                                                                                       // static evaluation score
-  U64 bitboard;                                                                                                        // current pieces bitboard copy
-  int piece, square;                                                                                                   // init piece & square
-  int double_pawns = 0;                                                                                                // penalties
+  return stm | (black_king << 1) | (white_king << 7) | ((pawn % 8) << 13) | ((pawn / 8 - 1) << 15);
+}
 
-  for (int bb_piece = P; bb_piece <= k; bb_piece++) {                                                                  // loop over piece bitboards
-    bitboard = bitboards[bb_piece];                                                                                    // init piece bitboard copy
+// result of a KPK position which doesn't depend on its successors
+int
+kpk_initial_result(int stm, int black_king, int white_king, int pawn)
+{
+  U64 promotion = 1ULL << (pawn - 8);                                                                                  // square in front of the pawn
 
-    while (bitboard) {                                                                                                 // loop over pieces within a bitboard
-      piece  = bb_piece;                                                                                               // init piece
-      square = get_ls1b_index(bitboard);                                                                               // init square
+  if (white_king == black_king || white_king == pawn || black_king == pawn) return kpk_invalid;                        // pieces on the same square
+  if (king_attacks[white_king] & (1ULL << black_king)) return kpk_invalid;                                             // kings touch
+  if (stm == WHITE && (pawn_attacks[WHITE][pawn] & (1ULL << black_king))) return kpk_invalid;                          // black king left in check
 
-      score += material_score[piece];                                                                                  // score material weights
+  if (stm == WHITE && pawn / 8 == 1 && white_king != pawn - 8 && black_king != pawn - 8 &&                             // pawn promotes and the queen can't be taken
+      ((king_attacks[black_king] & promotion) == 0 || (king_attacks[white_king] & promotion)))
+    return kpk_win;
 
-      switch (piece) {                                                                                                 // score positional piece scores
-        case P:                                                                                                        // evaluate white pawns
-          score        += pawn_score[square];                                                                          // positional score
-          double_pawns  = count_bits(bitboards[P] & file_masks[square]);                                               // double pawn penalty
-          if (double_pawns > 1)                                                                                        // on double pawns (tripple, etc)
-            score += double_pawns * double_pawn_penalty;
-          if ((bitboards[P] & isolated_masks[square]) == 0)                                                            // on isolated pawn
-            score += isolated_pawn_penalty;                                                                            // give an isolated pawn penalty
-          if ((white_passed_masks[square] & bitboards[p]) == 0)                                                        // on passed pawn
-            score += passed_pawn_bonus[get_rank[square]];                                                              // give passed pawn bonus
-          break;
-        case N:                                                                                                        // evaluate white knights
-          score += knight_score[square];                                                                               // positional score
-          break;
-        case B:                                                                                                        // evaluate white bishops
-          score += bishop_score[square];                                                                               // positional scores
-          score += count_bits(get_bishop_attacks(square, occupancies[BOTH]));                                          // mobility
-          break;
-        case R:                                                                                                        // evaluate white rooks
-          score += rook_score[square];                                                                                 // positional score
-          if ((bitboards[P] & file_masks[square]) == 0)                                                                // semi open file
-            score += semi_open_file_score;                                                                             // add semi open file bonus
-          if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0)                                               // semi open file
-            score += open_file_score;                                                                                  // add semi open file bonus
-          break;
-        case Q:                                                                                                        // evaluate white queens
-          score += count_bits(get_queen_attacks(square, occupancies[BOTH]));                                           // mobility
-          break;
-        case K:                                                                                                        // evaluate white king
-          score += king_score[square];                                                                                 // positional score
-          if ((bitboards[P] & file_masks[square]) == 0)                                                                // semi open file
-            score -= semi_open_file_score;                                                                             // add semi open file penalty
-          if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0)                                               // semi open file
-            score -= open_file_score;                                                                                  // add semi open file penalty
-          score += count_bits(king_attacks[square] & occupancies[WHITE]) * king_shield_bonus;                          // king safety bonus
-          break;
-        case p:                                                                                                        // evaluate black pawns
-          score -= pawn_score[mirror_score[square]];                                                                   // positional score
-          double_pawns = count_bits(bitboards[p] & file_masks[square]);                                                // double pawn penalty
+  if (stm == BLACK) {
+    if ((king_attacks[black_king] & ~(king_attacks[white_king] | pawn_attacks[WHITE][pawn])) == 0)                     // stalemate
+      return kpk_draw;
+    if (king_attacks[black_king] & ~king_attacks[white_king] & (1ULL << pawn))                                         // black king takes the pawn
+      return kpk_draw;
+  }
+  return kpk_unknown;
+}
 
-          if (double_pawns > 1)                                                                                        // on double pawns (tripple, etc)
-            score -= double_pawns * double_pawn_penalty;
+// result of a KPK position derived from the results of its successors
+int
+kpk_classify(unsigned char* results, int stm, int black_king, int white_king, int pawn)
+{
+  int successors = kpk_invalid;                                                                                        // union of successor results
+  U64 king_moves = king_attacks[(stm == WHITE) ? white_king : black_king];                                             // illegal king moves lead to invalid positions
+
+  while (king_moves) {
+    int target = get_ls1b_index(king_moves);
+    successors |= (stm == WHITE) ? results[kpk_index(BLACK, black_king, target, pawn)]
+                                 : results[kpk_index(WHITE, target, white_king, pawn)];
+    pop_bit(king_moves, target);
+  }
 
-          if ((bitboards[p] & isolated_masks[square]) == 0)                                                            // on isolated pawnd
-            score -= isolated_pawn_penalty;                                                                            // give an isolated pawn penalty
+  if (stm == WHITE) {
+    if (pawn / 8 > 1)                                                                                                  // pawn push (promotions are initial results)
+      successors |= results[kpk_index(BLACK, black_king, white_king, pawn - 8)];
+    if (pawn / 8 == 6 && pawn - 8 != white_king && pawn - 8 != black_king)                                             // double pawn push
+      successors |= results[kpk_index(BLACK, black_king, white_king, pawn - 16)];
 
-          if ((black_passed_masks[square] & bitboards[P]) == 0)                                                        // on passed pawn
-            score -= passed_pawn_bonus[get_rank[mirror_score[square]]];                                                // give passed pawn bonus
-          break;
-        case n:                                                                                                        // evaluate black knights
-          score -= knight_score[mirror_score[square]];                                                                 // positional score
-          break;
-        case b:                                                                                                        // evaluate black bishops
-          score -= bishop_score[mirror_score[square]];                                                                 // positional score
-          score -= count_bits(get_bishop_attacks(square, occupancies[BOTH]));                                          // mobility
-          break;
-        case r:                                                                                                        // evaluate black rooks
-          score -= rook_score[mirror_score[square]];                                                                   // positional score
-          if ((bitboards[p] & file_masks[square]) == 0)                                                                // semi open file
-            score -= semi_open_file_score;                                                                             // add semi open file bonus
-          if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0)                                               // semi open file
-            score -= open_file_score;                                                                                  // add semi open file bonus
-          break;
-        case q:                                                                                                        // evaluate black queens
-          score -= count_bits(get_queen_attacks(square, occupancies[BOTH]));                                           // mobility
+    return (successors & kpk_win) ? kpk_win : (successors & kpk_unknown) ? kpk_unknown : kpk_draw;                     // white needs one winning move
+  }
+  return (successors & kpk_draw) ? kpk_draw : (successors & kpk_unknown) ? kpk_unknown : kpk_win;                      // black needs one drawing move
+}
+
+// init KPK bitbase
+void
+init_kpk_bitbase()
+{
+  unsigned char* results = malloc(kpk_size);                                                                           // results of all positions
+  int changed = 1;
+
+  for (int index = 0; index < kpk_size; index++)                                                                       // decode index fields & classify what we can right away
+    results[index] = kpk_initial_result(index & 1, (index >> 1) & 63, (index >> 7) & 63,
+                                        ((index >> 15) + 1) * 8 + ((index >> 13) & 3));
+
+  while (changed) {                                                                                                    // iterate until no unknown position can be decided
+    changed = 0;
+    for (int index = 0; index < kpk_size; index++) {
+      if (results[index] != kpk_unknown) continue;
+      results[index] = kpk_classify(results, index & 1, (index >> 1) & 63, (index >> 7) & 63,
+                                    ((index >> 15) + 1) * 8 + ((index >> 13) & 3));
+      changed |= results[index] != kpk_unknown;
+    }
+  }
+
+  memset(kpk_bitbase, 0, sizeof(kpk_bitbase));
+  for (int index = 0; index < kpk_size; index++)                                                                       // positions still unknown are draws
+    if (results[index] == kpk_win) kpk_bitbase[index / 32] |= 1U << (index % 32);
+
+  free(results);
+}
+
+// does the side with the pawn win the current KPK position
+int
+kpk_probe(int strong)
+{
+  int strong_king = get_ls1b_index(bitboards[(strong == WHITE) ? K : k]);
+  int weak_king   = get_ls1b_index(bitboards[(strong == WHITE) ? k : K]);
+  int pawn        = get_ls1b_index(bitboards[(strong == WHITE) ? P : p]);
+
+  if (strong == BLACK) strong_king ^= 56, weak_king ^= 56, pawn ^= 56;                                                 // flip ranks so the pawn is white
+  if (pawn % 8 > 3)    strong_king ^= 7,  weak_king ^= 7,  pawn ^= 7;                                                  // mirror files so the pawn is on files a-d
+
+  int index = kpk_index((side == strong) ? WHITE : BLACK, weak_king, strong_king, pawn);
+  return (kpk_bitbase[index / 32] >> (index % 32)) & 1;
+}
+
+// Material table
+
+#define material_table_size 8192                                                                                       /* material table entries (a power of 2) */
+
+const int bishop_pair_bonus = 30;                                                                                      // bishop pair bonus
+const int knight_pawn_bonus =  6;                                                                                      // knight bonus per own pawn above 5 (knights like closed positions)
+const int rook_pawn_penalty = 12;                                                                                      // rook penalty per own pawn above 5 (rooks like open positions)
+const int known_win_bonus   = 500;                                                                                     // bonus for a won endgame, so the search steers into it
+
+enum { eg_none, eg_draw, eg_kxk, eg_kbnk, eg_kpk };                                                                    // specialized endgame evaluators
+
+typedef struct                                                                                                         // material table entry
+{
+  U64           key;                                                                                                   // material key
+  short         value;                                                                                                 // material plus imbalance (from white's point of view)
+  unsigned char phase;                                                                                                 // game phase (24 with all pieces on board, 0 with pawns & kings only)
+  unsigned char endgame;                                                                                               // specialized endgame evaluator (eg_none if there is none)
+  unsigned char strong_side;                                                                                           // side with the mating material (KXK & KBNK)
+} material_entry;
+
+_Thread_local material_entry material_table[material_table_size];                                                      // material table (filled on demand)
+
+// material, imbalance, phase & endgame evaluator of the current piece counts
+void
+init_material_entry(material_entry* entry)
+{
+  int count[12];                                                                                                       // piece counts
+  for (int piece = P; piece <= k; piece++) count[piece] = count_bits(bitboards[piece]);
+
+  int value = 0;
+  for (int piece = P; piece <= k; piece++) value += count[piece] * material_score[piece];                              // material
+
+  for (int color = WHITE; color <= BLACK; color++) {                                                                   // imbalance
+    int offset = (color == WHITE) ? 0 : 6;                                                                             // piece code offset of the color
+    int sign   = (color == WHITE) ? 1 : -1;
+    int pawns  = count[P + offset];
+
+    if (count[B + offset] >= 2) value += sign * bishop_pair_bonus;
+    if (pawns > 5) value += sign * (pawns - 5) * (count[N + offset] * knight_pawn_bonus - count[R + offset] * rook_pawn_penalty);
+  }
+
+  int phase = count[N] + count[n] + count[B] + count[b] + 2 * (count[R] + count[r]) + 4 * (count[Q] + count[q]);
+
+  int minors[2] = { count[N] + count[B], count[n] + count[b] };                                                        // minor pieces [side]
+  int majors[2] = { count[R] + count[Q], count[r] + count[q] };                                                        // major pieces [side]
+  int pawns[2]  = { count[P], count[p] };                                                                              // pawns [side]
+
+  entry->key         = material_key;
+  entry->value       = value;
+  entry->phase       = phase < 24 ? phase : 24;
+  entry->endgame     = eg_none;
+  entry->strong_side = WHITE;
+
+  if (pawns[WHITE] + pawns[BLACK] + majors[WHITE] + majors[BLACK] == 0 &&                                              // KK, KNK, KBK, KNKN, KNKB, KBKB & KNNK
+      ((minors[WHITE] <= 1 && minors[BLACK] <= 1) ||
+       (count[N] == 2 && minors[WHITE] == 2 && minors[BLACK] == 0) ||
+       (count[n] == 2 && minors[BLACK] == 2 && minors[WHITE] == 0))) {
+    entry->endgame = eg_draw;
+    return;
+  }
+
+  for (int strong = WHITE; strong <= BLACK; strong++) {                                                                // mating material against a bare king
+    int weak = strong ^ 1;
+    if (pawns[weak] + minors[weak] + majors[weak]) continue;                                                           // weak side is not a bare king
+
+    entry->strong_side = strong;
+    if (majors[strong])                                                                                                // KQK, KRK, ...
+      entry->endgame = eg_kxk;
+    else if (pawns[strong] == 0 && minors[strong] == 2 &&
+             count[(strong == WHITE) ? N : n] == 1)                                                                    // KBNK
+      entry->endgame = eg_kbnk;
+    else if (pawns[strong] == 1 && minors[strong] == 0)                                                                // KPK
+      entry->endgame = eg_kpk;
+  }
+}
+
+// material table entry of the current position
+material_entry*
+probe_material()
+{
+  material_entry* entry = &material_table[material_key & (material_table_size - 1)];
+  if (entry->key != material_key) init_material_entry(entry);                                                          // new material signature
+  return entry;
+}
+
+// how far is a square from the center (0 in the center, 6 in a corner)
+int
+edge_distance(int square)
+{
+  int file = square % 8, rank = square / 8;
+  return (3 - (file < 4 ? file : 7 - file)) + (3 - (rank < 4 ? rank : 7 - rank));
+}
+
+// king distance between two squares
+int
+square_distance(int square1, int square2)
+{
+  int files = abs(square1 % 8 - square2 % 8), ranks = abs(square1 / 8 - square2 / 8);
+  return files > ranks ? files : ranks;
+}
+
+// is the position a recognized draw
+int
+is_endgame_draw(material_entry* entry)
+{
+  return entry->endgame == eg_draw || (entry->endgame == eg_kpk && kpk_probe(entry->strong_side) == 0);
+}
+
+// score of a recognized endgame (from the side to move's point of view)
+int
+evaluate_endgame(material_entry* entry)
+{
+  if (is_endgame_draw(entry)) return 0;
+
+  int strong      = entry->strong_side;
+  int strong_king = get_ls1b_index(bitboards[(strong == WHITE) ? K : k]);
+  int weak_king   = get_ls1b_index(bitboards[(strong == WHITE) ? k : K]);
+  int score       = ((strong == WHITE) ? entry->value : -entry->value) + known_win_bonus;                              // material from the strong side's point of view
+
+  score += 10 * (7 - square_distance(strong_king, weak_king));                                                         // bring the kings together
+
+  if (entry->endgame == eg_kxk)
+    score += 20 * edge_distance(weak_king);                                                                            // drive the bare king to the edge
+  else if (entry->endgame == eg_kpk) {                                                                                 // KPK win: push the pawn
+    int pawn = get_ls1b_index(bitboards[(strong == WHITE) ? P : p]);
+    score += 20 * ((strong == WHITE) ? get_rank[pawn] : 7 - get_rank[pawn]);
+  }
+  else {                                                                                                               // KBNK: only the corners of the bishop's color are mating corners
+    int bishop = get_ls1b_index(bitboards[(strong == WHITE) ? B : b]);
+    int corner = ((bishop / 8 + bishop % 8) & 1) ? a1 : a8;                                                            // a8 & h1 are light squares
+    int mirror = (corner == a1) ? h8 : h1;
+    int near   = square_distance(weak_king, corner) < square_distance(weak_king, mirror)
+               ? square_distance(weak_king, corner) : square_distance(weak_king, mirror);
+    score += 20 * (7 - near);                                                                                          // drive the bare king to a mating corner
+  }
+
+  return (side == strong) ? score : -score;
+}
+
+// material, piece-square & pawn structure terms of the evaluation (from white's point of view)
+int
+evaluate_base(material_entry* material)
+{
+  int score = material->value;                                                                                         // static evaluation score (starts with material & imbalance)
+  U64 bitboard;                                                                                                        // current pieces bitboard copy
+  int piece, square;                                                                                                   // init piece & square
+  int double_pawns = 0;                                                                                                // penalties
+
+  for (int bb_piece = P; bb_piece <= k; bb_piece++) {                                                                  // loop over piece bitboards
+    bitboard = bitboards[bb_piece];                                                                                    // init piece bitboard copy
+
+    while (bitboard) {                                                                                                 // loop over pieces within a bitboard
+      piece  = bb_piece;                                                                                               // init piece
+      square = get_ls1b_index(bitboard);                                                                               // init square
+
+      switch (piece) {                                                                                                 // score positional piece scores
+        case P:                                                                                                        // evaluate white pawns
+          score        += pawn_score[square];                                                                          // positional score
+          double_pawns  = count_bits(bitboards[P] & file_masks[square]);                                               // double pawn penalty
+          if (double_pawns > 1)                                                                                        // on double pawns (tripple, etc)
+            score += double_pawns * double_pawn_penalty;
+          if ((bitboards[P] & isolated_masks[square]) == 0)                                                            // on isolated pawn
+            score += isolated_pawn_penalty;                                                                            // give an isolated pawn penalty
+          if ((white_passed_masks[square] & bitboards[p]) == 0)                                                        // on passed pawn
+            score += passed_pawn_bonus[get_rank[square]];                                                              // give passed pawn bonus
+          break;
+        case N:                                                                                                        // evaluate white knights
+          score += knight_score[square];                                                                               // positional score
+          break;
+        case B:                                                                                                        // evaluate white bishops
+          score += bishop_score[square];                                                                               // positional scores
+          break;
+        case R:                                                                                                        // evaluate white rooks
+          score += rook_score[square];                                                                                 // positional score
+          if ((bitboards[P] & file_masks[square]) == 0)                                                                // semi open file
+            score += semi_open_file_score;                                                                             // add semi open file bonus
+          if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0)                                               // semi open file
+            score += open_file_score;                                                                                  // add semi open file bonus
+          break;
+        case K:                                                                                                        // evaluate white king
+          score += king_score[square];                                                                                 // positional score
+          if ((bitboards[P] & file_masks[square]) == 0)                                                                // semi open file
+            score -= semi_open_file_score;                                                                             // add semi open file penalty
+          if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0)                                               // semi open file
+            score -= open_file_score;                                                                                  // add semi open file penalty
+          break;
+        case p:                                                                                                        // evaluate black pawns
+          score -= pawn_score[mirror_score[square]];                                                                   // positional score
+          double_pawns = count_bits(bitboards[p] & file_masks[square]);                                                // double pawn penalty
+
+          if (double_pawns > 1)                                                                                        // on double pawns (tripple, etc)
+            score -= double_pawns * double_pawn_penalty;
+
+          if ((bitboards[p] & isolated_masks[square]) == 0)                                                            // on isolated pawnd
+            score -= isolated_pawn_penalty;                                                                            // give an isolated pawn penalty
+
+          if ((black_passed_masks[square] & bitboards[P]) == 0)                                                        // on passed pawn
+            score -= passed_pawn_bonus[get_rank[mirror_score[square]]];                                                // give passed pawn bonus
+          break;
+        case n:                                                                                                        // evaluate black knights
+          score -= knight_score[mirror_score[square]];                                                                 // positional score
+          break;
+        case b:                                                                                                        // evaluate black bishops
+          score -= bishop_score[mirror_score[square]];                                                                 // positional score
+          break;
+        case r:                                                                                                        // evaluate black rooks
+          score -= rook_score[mirror_score[square]];                                                                   // positional score
+          if ((bitboards[p] & file_masks[square]) == 0)                                                                // semi open file
+            score -= semi_open_file_score;                                                                             // add semi open file bonus
+          if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0)                                               // semi open file
+            score -= open_file_score;                                                                                  // add semi open file bonus
           break;
         case k:                                                                                                        // evaluate black king
           score -= king_score[mirror_score[square]];                                                                   // positional score
@@ -1786,553 +2301,3828 @@ evaluate()
             score += semi_open_file_score;                                                                             // add semi open file penalty
           if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0)                                               // semi open file
             score += open_file_score;                                                                                  // add semi open file penalty
-          score -= count_bits(king_attacks[square] & occupancies[BLACK]) * king_shield_bonus;                          // king safety bonus
           break;
       }
       pop_bit(bitboard, square);                                                                                       // pop ls1b
     }
   }
 
-  return (side == WHITE) ? score : -score;                                                                             // return final evaluation based on side
+  return score;
+}
+
+// mobility & king safety terms of the evaluation (from white's point of view)
+int
+evaluate_activity()
+{
+  int score = 0;                                                                                                       // activity score
+  U64 bitboard;                                                                                                        // current pieces bitboard copy
+  int square;                                                                                                          // init square
+
+  for (bitboard = bitboards[B]; bitboard; pop_bit(bitboard, square)) {                                                 // white bishops mobility
+    square = get_ls1b_index(bitboard);
+    score += count_bits(get_bishop_attacks(square, occupancies[BOTH]));
+  }
+  for (bitboard = bitboards[b]; bitboard; pop_bit(bitboard, square)) {                                                 // black bishops mobility
+    square = get_ls1b_index(bitboard);
+    score -= count_bits(get_bishop_attacks(square, occupancies[BOTH]));
+  }
+  for (bitboard = bitboards[Q]; bitboard; pop_bit(bitboard, square)) {                                                 // white queens mobility
+    square = get_ls1b_index(bitboard);
+    score += count_bits(get_queen_attacks(square, occupancies[BOTH]));
+  }
+  for (bitboard = bitboards[q]; bitboard; pop_bit(bitboard, square)) {                                                 // black queens mobility
+    square = get_ls1b_index(bitboard);
+    score -= count_bits(get_queen_attacks(square, occupancies[BOTH]));
+  }
+
+  score += count_bits(king_attacks[get_ls1b_index(bitboards[K])] & occupancies[WHITE]) * king_shield_bonus;            // king safety bonus
+  score -= count_bits(king_attacks[get_ls1b_index(bitboards[k])] & occupancies[BLACK]) * king_shield_bonus;
+
+  return score;
+}
+
+// position evaluation
+int
+evaluate()
+{
+  material_entry* material = probe_material();                                                                         // material signature of the position
+  if (material->endgame) return evaluate_endgame(material);                                                            // recognized endgame
+
+  if (use_nnue) return nnue_evaluate();                                                                                // network evaluation
+  int score = evaluate_base(material) + evaluate_activity();                                                           // static evaluation score
+  return (side == WHITE) ? score : -score;                                                                             // return final evaluation based on side
+}
+
+// Lazy evaluation
+
+int lazy_margin = 150;                                                                                                 // activity terms never swing the score by more (UCI "LazyMargin")
+_Thread_local int lazy_exit;                                                                                           // last lazy evaluation skipped the activity terms
+_Thread_local U64 lazy_evals;                                                                                          // lazy evaluations since the search started
+_Thread_local U64 lazy_exits_high;                                                                                     // of which ended early above beta
+_Thread_local U64 lazy_exits_low;                                                                                      // and below alpha
+
+// position evaluation which skips the activity terms if the cheap terms alone are decisive for the alpha/beta window
+// (such an early exit returns a bound which is still outside the window, and sets lazy_exit)
+int
+lazy_evaluate(int alpha, int beta)
+{
+  lazy_exit = 0;
+  material_entry* material = probe_material();                                                                         // material signature of the position
+  if (material->endgame) return evaluate_endgame(material);                                                            // recognized endgame
+
+  if (use_nnue) return nnue_evaluate();                                                                                // network evaluation is all or nothing
+
+  int score = evaluate_base(material);                                                                                 // cheap terms first
+  if (side == BLACK) score = -score;
+
+  lazy_evals++;
+  if (score - lazy_margin >= beta) {                                                                                   // fails high whatever the activity terms say
+    lazy_exits_high++;
+    lazy_exit = 1;
+    return score - lazy_margin;                                                                                        // return a lower bound
+  }
+  if (score + lazy_margin <= alpha) {                                                                                  // fails low whatever the activity terms say
+    lazy_exits_low++;
+    lazy_exit = 1;
+    return score + lazy_margin;                                                                                        // return an upper bound
+  }
+
+  int activity = evaluate_activity();                                                                                  // score is close to the window, so finish the evaluation
+  return score + ((side == WHITE) ? activity : -activity);
+}
+
+// Evaluation cache
+
+// Lossy cache of static evaluations. Each entry is a single 64-bit word holding the upper 48 bits of the hash key
+// and the 16-bit score, so a torn or overwritten entry can only ever miss.
+
+int  eval_cache_mb = 4;                                                                                                // eval cache size in MB (UCI "EvalCache")
+U64* eval_cache;                                                                                                       // eval cache entries
+U64  eval_cache_mask;                                                                                                  // entries - 1 (entries is a power of 2)
+_Thread_local U64  eval_cache_probes;                                                                                  // lookups since the search started
+_Thread_local U64  eval_cache_hits;                                                                                    // successful lookups since the search started
+
+// clear eval cache (e.g. when the evaluation function changes)
+void
+clear_eval_cache()
+{
+  memset(eval_cache, 0, (eval_cache_mask + 1) * sizeof(U64));
+}
+
+// (re)allocate eval cache if its size has changed
+void
+init_eval_cache()
+{
+  U64 entries = 1;
+  while (entries * 2 * sizeof(U64) <= (U64)eval_cache_mb << 20) entries *= 2;                                          // largest power of 2 that fits
+
+  if (eval_cache && entries == eval_cache_mask + 1) return;                                                            // size unchanged
+
+  U64* cache = calloc(entries, sizeof(U64));
+
+  if (cache == NULL) {                                                                                                 // out of memory
+    printf("info string failed to allocate %d MB eval cache\n", eval_cache_mb);
+    if (eval_cache) return;                                                                                            // keep the previous table
+
+    entries = 1024;                                                                                                    // or fall back to a minimal one
+    cache   = calloc(entries, sizeof(U64));
+    if (cache == NULL) {
+      printf("  Failed to allocate eval cache!\n");
+      exit(1);
+    }
+  }
+
+  free(eval_cache);
+  eval_cache      = cache;
+  eval_cache_mask = entries - 1;
+}
+
+// static evaluation of the current position, looked up in the eval cache first (lazy on a miss, see lazy_evaluate)
+int
+cached_evaluate(int alpha, int beta)
+{
+  U64* entry = &eval_cache[hash_key & eval_cache_mask];
+  U64  data  = *entry;
+
+  eval_cache_probes++;
+  if (((data ^ hash_key) >> 16) == 0) {                                                                                // upper key bits match
+    eval_cache_hits++;
+    lazy_exit = 0;
+    return (short)(data & 0xffff);
+  }
+
+  int score = lazy_evaluate(alpha, beta);
+  if (lazy_exit == 0) *entry = (hash_key & ~0xffffULL) | (unsigned short)score;                                        // only exact scores are cached
+  return score;
+}
+
+
+// Syzygy tablebases
+
+// WDL (win/draw/loss) & DTZ (distance to zeroing move) probing of up to 5 men Syzygy files. The files are memory
+// mapped, and each one holds 1 (DTZ) or 2 (WDL, one per side to move) tables per leading pawn file a-d (1 table
+// without pawns). A table stores a value per position index, compressed in blocks of Huffman coded symbols, where
+// a symbol stands for a run of values ("recursive pairing"). The position index is a product of groups of like
+// pieces, each placed on the squares left by the groups before it. Tables use their own square & piece codes:
+// a1 = 0, h8 = 63, white pieces 1 (pawn) to 6 (king), black pieces 9 to 14.
+
+#define tb_pieces     5                                                                                                /* largest tablebases supported */
+#define tb_hash_size  1024                                                                                             /* material key hash (a power of 2) */
+#define tb_win_score  (mate_score - 2 * max_ply)                                                                       /* won tablebase position (below mate scores) */
+
+enum { tb_wdl, tb_dtz };                                                                                               // table types
+enum { tb_fail, tb_ok, tb_change_stm, tb_zeroing_best_move };                                                          // probe results
+enum { tb_flag_stm = 1, tb_flag_mapped = 2, tb_flag_win_plies = 4, tb_flag_loss_plies = 8,                             // table flags
+       tb_flag_wide = 16, tb_flag_single_value = 128 };
+
+typedef struct                                                                                                         // a compressed table
+{
+  unsigned char  flags;                                                                                                // table flags
+  unsigned char  max_sym_len;                                                                                          // longest Huffman code in bits
+  unsigned char  min_sym_len;                                                                                          // shortest Huffman code in bits (the value of single value tables)
+  unsigned int   block_count;                                                                                          // number of blocks
+  U64            block_size;                                                                                           // block size in bytes
+  U64            span;                                                                                                 // values per sparse index entry
+  unsigned char* lowest_sym;                                                                                           // lowest symbol of each code length (16 bit)
+  unsigned char* btree;                                                                                                // left & right symbol of each symbol (12 bits each)
+  unsigned char* block_length;                                                                                         // values per block - 1 (16 bit)
+  unsigned int   block_length_size;                                                                                    // block length entries (padded)
+  unsigned char* sparse_index;                                                                                         // block (32 bit) & offset (16 bit) every span values
+  U64            sparse_index_size;                                                                                    // sparse index entries
+  unsigned char* data;                                                                                                 // compressed blocks
+  U64*           base64;                                                                                               // lowest code of each length, left aligned
+  unsigned char* symlen;                                                                                               // values per symbol - 1
+  int            symbol_count;                                                                                         // number of symbols
+  int            pieces[tb_pieces];                                                                                    // piece codes in index order
+  U64            group_index[tb_pieces + 1];                                                                           // index factor of each group
+  int            group_length[tb_pieces + 1];                                                                          // pieces per group (zero terminated)
+  unsigned short map_index[4];                                                                                         // DTZ value maps of win, loss, cursed win & blessed loss
+} tb_pairs;
+
+typedef struct                                                                                                         // a tablebase (material signature)
+{
+  U64            key;                                                                                                  // material key with the first side of the name as white
+  U64            key2;                                                                                                 // material key with the first side of the name as black
+  int            piece_count;                                                                                          // men on board
+  int            has_pawns;                                                                                            // any pawns
+  int            has_unique_pieces;                                                                                    // any single piece of a kind (but kings)
+  int            pawn_count[2];                                                                                        // pawns of the leading & the other color
+  unsigned char* wdl_file;                                                                                             // mapped WDL file (NULL if missing)
+  unsigned char* dtz_file;                                                                                             // mapped DTZ file (NULL if missing)
+  U64            wdl_size, dtz_size;                                                                                   // their sizes
+  tb_pairs       wdl[4][2];                                                                                            // WDL tables [file][side to move]
+  tb_pairs       dtz[4];                                                                                               // DTZ tables [file]
+  unsigned char* dtz_map;                                                                                              // DTZ value maps
+} tb_entry;
+
+tb_entry* tb_entries[tb_hash_size];                                                                                    // tablebases by material key (both keys)
+int       tb_largest;                                                                                                  // men of the largest tablebase found
+int       tb_probe_limit = tb_pieces;                                                                                  // probe up to this many men (UCI "SyzygyProbeLimit")
+_Thread_local U64       tb_hits;                                                                                       // successful probes since the search started
+char      tb_path[1024];                                                                                               // tablebase directories (UCI "SyzygyPath")
+
+int tb_map_b1h1h7[64];                                                                                                 // square below the a1-h8 diagonal -> 0..27
+int tb_map_a1d1d4[64];                                                                                                 // square in the a1-d1-d4 triangle -> 0..9
+int tb_map_kk[10][64];                                                                                                 // legal king pairs -> 0..461
+U64 tb_binomial[6][64];                                                                                                // ways to choose k of n squares [k][n]
+int tb_map_pawns[64];                                                                                                  // pawn square -> 0..47 (higher is nearer the edge & lower)
+int tb_lead_pawn_index[6][64];                                                                                         // index of the leading pawns [count][square]
+int tb_lead_pawns_size[6][4];                                                                                          // leading pawn indices [count][file]
+
+#define tb_file(square)        ((square) & 7)
+#define tb_rank(square)        ((square) >> 3)
+#define tb_off_diagonal(sq)    (tb_rank(sq) - tb_file(sq))                                                             /* > 0 above, < 0 below the a1-h8 diagonal */
+#define tb_read16(p)           ((p)[0] | (p)[1] << 8)                                                                  /* little endian reads */
+#define tb_read32(p)           ((unsigned int)(p)[0] | (p)[1] << 8 | (p)[2] << 16 | (unsigned int)(p)[3] << 24)
+#define tb_read32_be(p)        ((unsigned int)(p)[0] << 24 | (p)[1] << 16 | (p)[2] << 8 | (p)[3])                      /* big endian read */
+#define tb_left(d, sym)        (((d)->btree[3 * (sym) + 1] & 0xf) << 8 | (d)->btree[3 * (sym)])                        /* btree symbols */
+#define tb_right(d, sym)       ((d)->btree[3 * (sym) + 2] << 4 | (d)->btree[3 * (sym) + 1] >> 4)
+
+// init tablebase index encoding tables
+void
+init_tb_tables()
+{
+  int code = 0, diagonal[4], diagonal_count = 0;
+
+  for (int square = 0; square < 64; square++)
+    if (tb_off_diagonal(square) < 0) tb_map_b1h1h7[square] = code++;
+
+  code = 0;
+  for (int square = 0; square <= 27; square++) {                                                                       // a1 .. d4
+    if      (tb_off_diagonal(square) <  0 && tb_file(square) <= 3) tb_map_a1d1d4[square] = code++;
+    else if (tb_off_diagonal(square) == 0 && tb_file(square) <= 3) diagonal[diagonal_count++] = square;
+  }
+  for (int index = 0; index < diagonal_count; index++) tb_map_a1d1d4[diagonal[index]] = code++;                        // diagonal squares come last
+
+  int both_on_diagonal[64][2], both_count = 0;
+  code = 0;
+  for   (int index = 0; index < 10; index++) {
+    for (int square1 = 0; square1 <= 27; square1++) {
+      if (tb_file(square1) > 3 || tb_off_diagonal(square1) > 0 || tb_map_a1d1d4[square1] != index) continue;
+      if (index == 0 && square1 != 1) continue;                                                                        // b1 is mapped to 0
+      for (int square2 = 0; square2 < 64; square2++) {
+        if (abs(tb_file(square1) - tb_file(square2)) <= 1 && abs(tb_rank(square1) - tb_rank(square2)) <= 1) continue;  // kings touch
+        if (tb_off_diagonal(square1) == 0 && tb_off_diagonal(square2) > 0) continue;                                   // first on the diagonal, second above
+        if (tb_off_diagonal(square1) == 0 && tb_off_diagonal(square2) == 0) {                                          // both on the diagonal come last
+          both_on_diagonal[both_count][0] = index;
+          both_on_diagonal[both_count++][1] = square2;
+        }
+        else tb_map_kk[index][square2] = code++;
+      }
+    }
+  }
+  for (int index = 0; index < both_count; index++) tb_map_kk[both_on_diagonal[index][0]][both_on_diagonal[index][1]] = code++;
+
+  tb_binomial[0][0] = 1;
+  for   (int n = 1; n < 64; n++)
+    for (int k = 0; k < 6 && k <= n; k++)
+      tb_binomial[k][n] = (k > 0 ? tb_binomial[k - 1][n - 1] : 0) + (k < n ? tb_binomial[k][n - 1] : 0);
+
+  int available = 47;
+  for   (int count = 1; count <= 5; count++) {
+    for (int file = 0; file < 4; file++) {
+      int index = 0;
+      for (int rank = 1; rank <= 6; rank++) {
+        int square = rank * 8 + file;
+        if (count == 1) {
+          tb_map_pawns[square]      = available--;
+          tb_map_pawns[square ^ 7]  = available--;
+        }
+        tb_lead_pawn_index[count][square] = index;
+        index += tb_binomial[count - 1][tb_map_pawns[square]];
+      }
+      tb_lead_pawns_size[count][file] = index;
+    }
+  }
+}
+
+// symbol count of a symbol (values - 1), recursively from its children
+int
+tb_set_symlen(tb_pairs* d, int symbol, unsigned char* visited)
+{
+  visited[symbol] = 1;
+  int right = tb_right(d, symbol);
+  if (right == 0xfff) return 0;                                                                                        // a leaf
+  int left  = tb_left(d, symbol);
+  if (!visited[left])  d->symlen[left]  = tb_set_symlen(d, left, visited);
+  if (!visited[right]) d->symlen[right] = tb_set_symlen(d, right, visited);
+  return d->symlen[left] + d->symlen[right] + 1;
+}
+
+// read the Huffman & block layout of a table, returns the data after it
+unsigned char*
+tb_set_sizes(tb_pairs* d, unsigned char* data)
+{
+  d->flags = *data++;
+  if (d->flags & tb_flag_single_value) {                                                                               // whole table is one value
+    d->block_count = 0, d->span = 0, d->sparse_index_size = 0, d->block_length_size = 0;
+    d->min_sym_len = *data++;
+    return data;
+  }
+
+  int groups = 0;
+  while (d->group_length[groups]) groups++;
+  U64 table_size = d->group_index[groups];                                                                             // positions in the table
+
+  d->block_size        = 1ULL << *data++;
+  d->span              = 1ULL << *data++;
+  d->sparse_index_size = (table_size + d->span - 1) / d->span;
+  int padding          = *data++;
+  d->block_count       = tb_read32(data); data += 4;
+  d->block_length_size = d->block_count + padding;                                                                     // padded so the sparse index can't point out of range
+  d->max_sym_len       = *data++;
+  d->min_sym_len       = *data++;
+  d->lowest_sym        = data;
+
+  int lengths = d->max_sym_len - d->min_sym_len + 1;                                                                   // canonical Huffman code
+  d->base64   = calloc(lengths, sizeof(U64));
+  for (int index = lengths - 2; index >= 0; index--)
+    d->base64[index] = (d->base64[index + 1] + tb_read16(d->lowest_sym + 2 * index)
+                                             - tb_read16(d->lowest_sym + 2 * index + 2)) / 2;
+  for (int index = 0; index < lengths; index++)
+    d->base64[index] <<= 64 - index - d->min_sym_len;                                                                  // left align
+  data += 2 * lengths;
+
+  d->symbol_count = tb_read16(data); data += 2;
+  d->btree        = data;
+  d->symlen       = calloc(d->symbol_count, 1);
+
+  unsigned char* visited = calloc(d->symbol_count, 1);
+  for (int symbol = 0; symbol < d->symbol_count; symbol++)
+    if (!visited[symbol]) d->symlen[symbol] = tb_set_symlen(d, symbol, visited);
+  free(visited);
+
+  return data + 3 * d->symbol_count + (d->symbol_count & 1);
+}
+
+// split the pieces of a table into groups & compute the index factor of each group
+void
+tb_set_groups(tb_entry* entry, tb_pairs* d, int* order, int file)
+{
+  int groups = 0, first_length = entry->has_pawns ? 0 : entry->has_unique_pieces ? 3 : 2;
+
+  d->group_length[groups] = 1;
+  for (int index = 1; index < entry->piece_count; index++) {                                                           // like pieces form a group (the first 2 or 3 unique pieces too)
+    if (--first_length > 0 || d->pieces[index] == d->pieces[index - 1]) d->group_length[groups]++;
+    else                                                                   d->group_length[++groups] = 1;
+  }
+  d->group_length[++groups] = 0;
+
+  int both_pawns = entry->has_pawns && entry->pawn_count[1];                                                           // pawns on both sides
+  int next       = both_pawns ? 2 : 1;
+  int free_squares = 64 - d->group_length[0] - (both_pawns ? d->group_length[1] : 0);
+  U64 index      = 1;
+
+  for (int group = 0; next < groups || group == order[0] || group == order[1]; group++) {                              // groups are encoded in table order
+    if (group == order[0]) {                                                                                           // leading pawns or pieces
+      d->group_index[0] = index;
+      index *= entry->has_pawns ? tb_lead_pawns_size[d->group_length[0]][file] : entry->has_unique_pieces ? 31332 : 462;
+    }
+    else if (group == order[1]) {                                                                                      // other pawns
+      d->group_index[1] = index;
+      index *= tb_binomial[d->group_length[1]][48 - d->group_length[0]];
+    }
+    else {                                                                                                             // other pieces
+      d->group_index[next] = index;
+      index *= tb_binomial[d->group_length[next]][free_squares];
+      free_squares -= d->group_length[next++];
+    }
+  }
+  d->group_index[groups] = index;
+}
+
+// read the DTZ value maps, returns the data after them
+unsigned char*
+tb_set_dtz_map(tb_entry* entry, unsigned char* data, int files)
+{
+  entry->dtz_map = data;
+  for (int file = 0; file < files; file++) {
+    tb_pairs* d = &entry->dtz[file];
+    if ((d->flags & tb_flag_mapped) == 0) continue;
+    if (d->flags & tb_flag_wide) {
+      data += (data - entry->dtz_file) & 1;                                                                            // word alignment
+      for (int index = 0; index < 4; index++) {
+        d->map_index[index] = (data - entry->dtz_map) / 2 + 1;
+        data += 2 * tb_read16(data) + 2;
+      }
+    }
+    else {
+      for (int index = 0; index < 4; index++) {
+        d->map_index[index] = data - entry->dtz_map + 1;
+        data += *data + 1;
+      }
+    }
+  }
+  return data + ((data - entry->dtz_file) & 1);
+}
+
+// parse a mapped WDL or DTZ file
+void
+tb_setup(tb_entry* entry, int type, unsigned char* file)
+{
+  unsigned char* data  = file + 5;                                                                                     // skip magic & flags
+  int sides            = (type == tb_wdl && entry->key != entry->key2) ? 2 : 1;
+  int files            = entry->has_pawns ? 4 : 1;
+  int both_pawns       = entry->has_pawns && entry->pawn_count[1];
+
+  for (int file_index = 0; file_index < files; file_index++) {
+    int order[2][2] = { { *data & 0xf, both_pawns ? data[1] & 0xf : 0xf },
+                        { *data >> 4,  both_pawns ? data[1] >> 4  : 0xf } };
+    data += 1 + both_pawns;
+
+    for (int index = 0; index < entry->piece_count; index++, data++)
+      for (int stm = 0; stm < sides; stm++) {
+        tb_pairs* d = (type == tb_wdl) ? &entry->wdl[file_index][stm] : &entry->dtz[file_index];
+        d->pieces[index] = stm ? *data >> 4 : *data & 0xf;
+      }
+
+    for (int stm = 0; stm < sides; stm++)
+      tb_set_groups(entry, (type == tb_wdl) ? &entry->wdl[file_index][stm] : &entry->dtz[file_index], order[stm], file_index);
+  }
+  data += (data - file) & 1;                                                                                           // word alignment
+
+  for   (int file_index = 0; file_index < files; file_index++)
+    for (int stm = 0; stm < sides; stm++)
+      data = tb_set_sizes((type == tb_wdl) ? &entry->wdl[file_index][stm] : &entry->dtz[file_index], data);
+
+  if (type == tb_dtz) data = tb_set_dtz_map(entry, data, files);
+
+  for   (int file_index = 0; file_index < files; file_index++)
+    for (int stm = 0; stm < sides; stm++) {
+      tb_pairs* d = (type == tb_wdl) ? &entry->wdl[file_index][stm] : &entry->dtz[file_index];
+      d->sparse_index = data;
+      data += 6 * d->sparse_index_size;
+    }
+  for   (int file_index = 0; file_index < files; file_index++)
+    for (int stm = 0; stm < sides; stm++) {
+      tb_pairs* d = (type == tb_wdl) ? &entry->wdl[file_index][stm] : &entry->dtz[file_index];
+      d->block_length = data;
+      data += 2 * d->block_length_size;
+    }
+  for   (int file_index = 0; file_index < files; file_index++)
+    for (int stm = 0; stm < sides; stm++) {
+      tb_pairs* d = (type == tb_wdl) ? &entry->wdl[file_index][stm] : &entry->dtz[file_index];
+      data  = file + (((data - file) + 0x3f) & ~0x3f);                                                                 // 64 byte alignment
+      d->data = data;
+      data += d->block_count * d->block_size;
+    }
+}
+
+// value stored at a table index
+int
+tb_decompress(tb_pairs* d, U64 index)
+{
+  if (d->flags & tb_flag_single_value) return d->min_sym_len;
+
+  unsigned int k     = index / d->span;                                                                                // locate the block through the sparse index
+  unsigned int block = tb_read32(d->sparse_index + 6 * k);
+  int offset         = tb_read16(d->sparse_index + 6 * k + 4) + (int)(index % d->span) - (int)(d->span / 2);
+
+  while (offset < 0) {                                                                                                 // the offset may lie in a block before or after
+    block--;
+    offset += tb_read16(d->block_length + 2 * block) + 1;
+  }
+  while (offset > tb_read16(d->block_length + 2 * block)) {
+    offset -= tb_read16(d->block_length + 2 * block) + 1;
+    block++;
+  }
+
+  unsigned char* pointer = d->data + block * d->block_size;                                                            // decode symbols until the one holding the offset
+  U64 buffer             = (U64)tb_read32_be(pointer) << 32 | tb_read32_be(pointer + 4);
+  int buffer_bits        = 64;
+  int symbol;
+  pointer += 8;
+
+  while (1) {
+    int length = 0;
+    while (buffer < d->base64[length]) length++;
+    symbol  = (buffer - d->base64[length]) >> (64 - length - d->min_sym_len);
+    symbol += tb_read16(d->lowest_sym + 2 * length);
+    if (offset < d->symlen[symbol] + 1) break;
+    offset      -= d->symlen[symbol] + 1;
+    length      += d->min_sym_len;
+    buffer     <<= length;
+    buffer_bits -= length;
+    if (buffer_bits <= 32) {                                                                                           // refill
+      buffer_bits += 32;
+      buffer      |= (U64)tb_read32_be(pointer) << (64 - buffer_bits);
+      pointer     += 4;
+    }
+  }
+
+  while (d->symlen[symbol]) {                                                                                          // expand the symbol down to the value
+    int left = tb_left(d, symbol);
+    if (offset < d->symlen[left] + 1) symbol = left;
+    else {
+      offset -= d->symlen[left] + 1;
+      symbol  = tb_right(d, symbol);
+    }
+  }
+  return tb_left(d, symbol);
+}
+
+// tablebase of the current material (NULL if none)
+tb_entry*
+tb_find()
+{
+  for (int index = material_key & (tb_hash_size - 1); tb_entries[index]; index = (index + 1) & (tb_hash_size - 1))
+    if (tb_entries[index]->key == material_key || tb_entries[index]->key2 == material_key) return tb_entries[index];
+  return NULL;
+}
+
+// table piece code of a square (0 if empty)
+int
+tb_piece_on(int square)
+{
+  for (int piece = P; piece <= k; piece++)
+    if (get_bit(bitboards[piece], square)) return (piece < p) ? piece + 1 : piece - p + 9;
+  return 0;
+}
+
+// probe a WDL (wdl ignored) or DTZ (wdl of the position given) table for the current position
+int
+tb_probe_table(int type, int wdl, int* result)
+{
+  if (count_bits(occupancies[BOTH]) == 2) return *result = tb_ok, 0;                                                   // KvK
+
+  tb_entry* entry = tb_find();
+  if (entry == NULL || (type == tb_wdl ? entry->wdl_file : entry->dtz_file) == NULL) return *result = tb_fail, 0;
+
+  int squares[tb_pieces] = { 0 }, pieces[tb_pieces] = { 0 };
+  int size = 0, lead_pawns = 0, table_file = 0, next = 0;
+  U64 index, lead_pawn_bits = 0;
+
+  int flip      = (entry->key == entry->key2 && side == BLACK) || material_key != entry->key;                          // the table is stored from black's point of view
+  int flip_color   = flip * 8;
+  int flip_squares = flip * 56;
+  int stm          = flip ^ side;
+
+  if (entry->has_pawns) {                                                                                              // the leading pawns come first
+    int pawn = ((type == tb_wdl) ? entry->wdl[0][0].pieces[0] : entry->dtz[0].pieces[0]) ^ flip_color;                 // pawns of the leading color
+    lead_pawn_bits = bitboards[(pawn == 1) ? P : p];
+    for (U64 bitboard = lead_pawn_bits; bitboard; pop_bit(bitboard, get_ls1b_index(bitboard)))
+      squares[size++] = (get_ls1b_index(bitboard) ^ 56) ^ flip_squares;                                                // board squares count from a8
+    lead_pawns = size;
+
+    int best = 0;                                                                                                      // leading pawn is nearest the edge & lowest
+    for (int i = 1; i < lead_pawns; i++) if (tb_map_pawns[squares[i]] > tb_map_pawns[squares[best]]) best = i;
+    int swap = squares[0]; squares[0] = squares[best]; squares[best] = swap;
+    table_file = tb_file(squares[0]) < 4 ? tb_file(squares[0]) : 7 - tb_file(squares[0]);
+  }
+
+  if (type == tb_dtz && (entry->dtz[table_file].flags & tb_flag_stm) != stm &&                                         // DTZ tables hold one side to move
+      !(entry->key == entry->key2 && !entry->has_pawns))
+    return *result = tb_change_stm, 0;
+
+  for (U64 bitboard = occupancies[BOTH] & ~lead_pawn_bits; bitboard; pop_bit(bitboard, get_ls1b_index(bitboard))) {
+    int square     = get_ls1b_index(bitboard);
+    squares[size]  = (square ^ 56) ^ flip_squares;
+    pieces[size++] = tb_piece_on(square) ^ flip_color;
+  }
+
+  tb_pairs* d = (type == tb_wdl) ? &entry->wdl[table_file][stm] : &entry->dtz[table_file];
+
+  for   (int i = lead_pawns; i < size - 1; i++)                                                                        // order the pieces like the table
+    for (int j = i + 1; j < size; j++)
+      if (d->pieces[i] == pieces[j]) {
+        int swap = pieces[i];  pieces[i]  = pieces[j];  pieces[j]  = swap;
+        swap     = squares[i]; squares[i] = squares[j]; squares[j] = swap;
+        break;
+      }
+
+  if (tb_file(squares[0]) > 3)                                                                                         // leading piece on files a-d
+    for (int i = 0; i < size; i++) squares[i] ^= 7;
+
+  if (entry->has_pawns) {
+    index = tb_lead_pawn_index[lead_pawns][squares[0]];
+    for (int i = 2; i < lead_pawns; i++)                                                                               // other leading pawns in ascending pawn map order
+      for (int j = i; j > 1 && tb_map_pawns[squares[j]] < tb_map_pawns[squares[j - 1]]; j--) {
+        int swap = squares[j]; squares[j] = squares[j - 1]; squares[j - 1] = swap;
+      }
+    for (int i = 1; i < lead_pawns; i++) index += tb_binomial[i][tb_map_pawns[squares[i]]];
+  }
+  else {
+    if (tb_rank(squares[0]) > 3)                                                                                       // leading piece on ranks 1-4
+      for (int i = 0; i < size; i++) squares[i] ^= 56;
+
+    for (int i = 0; i < d->group_length[0]; i++) {                                                                     // first leading piece off the diagonal goes below it
+      if (tb_off_diagonal(squares[i]) == 0) continue;
+      if (tb_off_diagonal(squares[i]) > 0)
+        for (int j = i; j < size; j++) squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+      break;
+    }
+
+    if (entry->has_unique_pieces) {                                                                                    // 3 leading pieces
+      int adjust1 = squares[1] > squares[0];
+      int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+
+      if (tb_off_diagonal(squares[0]))
+        index = (tb_map_a1d1d4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+      else if (tb_off_diagonal(squares[1]))
+        index = (6 * 63 + tb_rank(squares[0]) * 28 + tb_map_b1h1h7[squares[1]]) * 62 + squares[2] - adjust2;
+      else if (tb_off_diagonal(squares[2]))
+        index = 6 * 63 * 62 + 4 * 28 * 62 + tb_rank(squares[0]) * 7 * 28 + (tb_rank(squares[1]) - adjust1) * 28
+              + tb_map_b1h1h7[squares[2]];
+      else
+        index = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + tb_rank(squares[0]) * 7 * 6 + (tb_rank(squares[1]) - adjust1) * 6
+              + (tb_rank(squares[2]) - adjust2);
+    }
+    else index = tb_map_kk[tb_map_a1d1d4[squares[0]]][squares[1]];                                                     // just the kings
+  }
+
+  index *= d->group_index[0];                                                                                          // other groups, each in ascending square order
+  int* group = squares + d->group_length[0];
+  int remaining_pawns = entry->has_pawns && entry->pawn_count[1];
+
+  while (d->group_length[++next]) {
+    int length = d->group_length[next];
+    for   (int i = 1; i < length; i++)
+      for (int j = i; j > 0 && group[j] < group[j - 1]; j--) {
+        int swap = group[j]; group[j] = group[j - 1]; group[j - 1] = swap;
+      }
+
+    U64 n = 0;
+    for (int i = 0; i < length; i++) {
+      int adjust = 0;                                                                                                  // squares taken by the groups before
+      for (int* square = squares; square < group; square++) adjust += group[i] > *square;
+      n += tb_binomial[i + 1][group[i] - adjust - 8 * remaining_pawns];
+    }
+    remaining_pawns = 0;
+    index += n * d->group_index[next];
+    group += length;
+  }
+
+  int value = tb_decompress(d, index);
+  *result   = tb_ok;
+  if (type == tb_wdl) return value - 2;
+
+  static const int wdl_map[] = { 1, 3, 0, 2, 0 };                                                                      // loss, blessed loss, draw, cursed win, win -> map
+  if (d->flags & tb_flag_mapped) {
+    if (d->flags & tb_flag_wide) value = tb_read16(entry->dtz_map + 2 * (d->map_index[wdl_map[wdl + 2]] + value));
+    else                         value = entry->dtz_map[d->map_index[wdl_map[wdl + 2]] + value];
+  }
+  if ((wdl == 2 && !(d->flags & tb_flag_win_plies)) || (wdl == -2 && !(d->flags & tb_flag_loss_plies)) ||              // moves to plies
+      wdl == 1 || wdl == -1)
+    value *= 2;
+  return value + 1;
+}
+
+// fill a move list with the legal moves of the current position
+void
+tb_legal_moves(moves* move_list)
+{
+  moves pseudo[1];
+  generate_moves(pseudo);
+  move_list->count = 0;
+  for (int count = 0; count < pseudo->count; count++) {
+    copy_board();
+    if (make_move(pseudo->moves[count], all_moves)) move_list->moves[move_list->count++] = pseudo->moves[count];
+    take_back();
+  }
+}
+
+// is the side to move in check
+int
+tb_in_check()
+{
+  return is_square_attacked(get_ls1b_index(bitboards[(side == WHITE) ? K : k]), side ^ 1);
+}
+
+// WDL of the current position, resolving captures (& pawn moves for DTZ) first as the tables don't care about them
+int
+tb_search(int zeroing_moves, int* result)
+{
+  moves move_list[1];
+  int best = -2, value, searched = 0;
+
+  tb_legal_moves(move_list);
+  for (int count = 0; count < move_list->count; count++) {
+    int move  = move_list->moves[count];
+    int piece = get_move_piece(move);
+    if (!get_move_capture(move) && (!zeroing_moves || (piece != P && piece != p))) continue;
+
+    searched++;
+    copy_board();
+    make_move(move, all_moves);
+    value = -tb_search(0, result);
+    take_back();
+
+    if (*result == tb_fail) return 0;
+    if (value > best) {
+      best = value;
+      if (value >= 2) return *result = tb_zeroing_best_move, value;
+    }
+  }
+
+  int no_more_moves = searched && searched == move_list->count;                                                        // all moves searched, the table may be wrong (e.g. enpassant)
+  if (no_more_moves) value = best;
+  else {
+    value = tb_probe_table(tb_wdl, 0, result);
+    if (*result == tb_fail) return 0;
+  }
+
+  if (best >= value) return *result = (best > 0 || no_more_moves) ? tb_zeroing_best_move : tb_ok, best;
+  return *result = tb_ok, value;
+}
+
+// probe WDL: -2 loss, -1 blessed loss (50 move draw), 0 draw, 1 cursed win (50 move draw), 2 win
+int
+tb_probe_wdl(int* result)
+{
+  *result = tb_ok;
+  return tb_search(0, result);
+}
+
+// DTZ of a zeroing move's position from its WDL
+int
+tb_dtz_before_zeroing(int wdl)
+{
+  return wdl == 2 ? 1 : wdl == 1 ? 101 : wdl == -1 ? -101 : wdl == -2 ? -1 : 0;
+}
+
+// probe DTZ: plies to a zeroing move (positive winning, negative losing, 0 draw), +-100 added for 50 move draws
+int
+tb_probe_dtz(int* result)
+{
+  *result = tb_ok;
+  int wdl = tb_search(1, result);
+  if (*result == tb_fail || wdl == 0) return 0;
+  if (*result == tb_zeroing_best_move) return tb_dtz_before_zeroing(wdl);
+
+  int dtz = tb_probe_table(tb_dtz, wdl, result);
+  if (*result == tb_fail) return 0;
+  if (*result != tb_change_stm) return (dtz + 100 * (wdl == 1 || wdl == -1)) * (wdl > 0 ? 1 : -1);
+
+  moves move_list[1];                                                                                                  // table is for the other side: 1 ply search
+  int min_dtz = 0xffff;
+
+  tb_legal_moves(move_list);
+  for (int count = 0; count < move_list->count; count++) {
+    int move    = move_list->moves[count];
+    int piece   = get_move_piece(move);
+    int zeroing = get_move_capture(move) || piece == P || piece == p;
+
+    copy_board();
+    make_move(move, all_moves);
+    dtz = zeroing ? -tb_dtz_before_zeroing(tb_search(0, result)) : -tb_probe_dtz(result);
+
+    if (dtz == 1 && tb_in_check()) {                                                                                   // mating move
+      moves replies[1];
+      tb_legal_moves(replies);
+      if (replies->count == 0) min_dtz = 1;
+    }
+    take_back();
+
+    if (!zeroing) dtz += (dtz > 0) - (dtz < 0);
+    if (dtz < min_dtz && (dtz > 0) == (wdl > 0) && dtz) min_dtz = dtz;
+    if (*result == tb_fail) return 0;
+  }
+  return min_dtz == 0xffff ? -1 : min_dtz;
+}
+
+// keep the root moves which preserve the tablebase result (fastest wins, longest losses), returns their count
+int
+tb_root_moves(int* root_moves)
+{
+  if (tb_largest == 0 || castle || count_bits(occupancies[BOTH]) > tb_probe_limit) return 0;
+
+  moves move_list[1];
+  int ranks[256], best_rank = -100000, result;
+
+  tb_legal_moves(move_list);
+  for (int count = 0; count < move_list->count; count++) {
+    int dtz;
+    copy_board();
+    make_move(move_list->moves[count], all_moves);
+
+    if (fifty == 0) dtz = tb_dtz_before_zeroing(-tb_probe_wdl(&result));                                               // zeroing move
+    else {
+      dtz  = -tb_probe_dtz(&result);
+      dtz += (dtz > 0) - (dtz < 0);
+    }
+    if (dtz == 2 && tb_in_check()) {                                                                                   // mating move
+      moves replies[1];
+      tb_legal_moves(replies);
+      if (replies->count == 0) dtz = 1;
+    }
+    take_back();
+    if (result == tb_fail) return 0;
+
+    if      (dtz > 0) ranks[count] = (dtz + fifty <= 100) ? 1000 - dtz : 0;                                            // wins beyond the 50 move rule are draws
+    else if (dtz < 0) ranks[count] = (-dtz + fifty <= 100) ? -1000 - dtz : 0;
+    else              ranks[count] = 0;
+    if (ranks[count] > best_rank) best_rank = ranks[count];
+  }
+
+  int kept = 0;
+  for (int count = 0; count < move_list->count; count++)
+    if (ranks[count] == best_rank) root_moves[kept++] = move_list->moves[count];
+
+  tb_hits++;
+  return kept;
+}
+
+// map a tablebase file from one of the tablebase directories
+unsigned char*
+tb_map_file(char* name, char* extension, U64* size)
+{
+  char paths[1024], file_name[1200];
+  strcpy(paths, tb_path);
+
+  for (char* directory = strtok(paths, ":"); directory; directory = strtok(NULL, ":")) {                               // directories are separated by ':'
+    sprintf(file_name, "%s/%s%s", directory, name, extension);
+    int descriptor = open(file_name, O_RDONLY);
+    if (descriptor < 0) continue;
+
+    struct stat status;
+    fstat(descriptor, &status);
+    void* data = (status.st_size % 64 == 16) ? mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, descriptor, 0) : MAP_FAILED;
+    close(descriptor);
+    if (data == MAP_FAILED) continue;
+
+    static const unsigned char magic[2][4] = { { 0x71, 0xe8, 0x23, 0x5d }, { 0xd7, 0x66, 0x0c, 0xa5 } };
+    if (memcmp(data, magic[strcmp(extension, ".rtbz") == 0], 4)) {                                                     // not a Syzygy file
+      munmap(data, status.st_size);
+      continue;
+    }
+    *size = status.st_size;
+    return data;
+  }
+  return NULL;
+}
+
+// register the tablebase of a name like "KRPvKR" if its files exist
+void
+tb_add(char* name)
+{
+  U64 wdl_size = 0, dtz_size = 0;
+  unsigned char* wdl_file = tb_map_file(name, ".rtbw", &wdl_size);
+  if (wdl_file == NULL) return;
+
+  tb_entry* entry = calloc(1, sizeof(tb_entry));
+  int counts[12] = { 0 }, color = WHITE;
+
+  for (char* c = name; *c; c++) {                                                                                      // count pieces of the first side as white
+    if (*c == 'v') { color = BLACK; continue; }
+    counts[char_pieces[(unsigned char)*c] + 6 * color]++;
+    entry->piece_count++;
+  }
+
+  for (int piece = P; piece <= K; piece++) {
+    entry->key  += counts[piece] * material_keys[piece] + counts[piece + 6] * material_keys[piece + 6];
+    entry->key2 += counts[piece] * material_keys[piece + 6] + counts[piece + 6] * material_keys[piece];
+    if (piece != K && (counts[piece] == 1 || counts[piece + 6] == 1)) entry->has_unique_pieces = 1;
+  }
+  entry->has_pawns = counts[P] + counts[p] > 0;
+
+  int white_leads = counts[p] == 0 || (counts[P] && counts[p] >= counts[P]);                                           // the side with fewer pawns leads
+  entry->pawn_count[0] = white_leads ? counts[P] : counts[p];
+  entry->pawn_count[1] = white_leads ? counts[p] : counts[P];
+
+  entry->wdl_file = wdl_file, entry->wdl_size = wdl_size;
+  tb_setup(entry, tb_wdl, wdl_file);
+  entry->dtz_file = tb_map_file(name, ".rtbz", &dtz_size), entry->dtz_size = dtz_size;
+  if (entry->dtz_file) tb_setup(entry, tb_dtz, entry->dtz_file);
+
+  for (int pass = 0; pass < 2; pass++) {                                                                               // insert under both keys
+    U64 key   = pass ? entry->key2 : entry->key;
+    int index = key & (tb_hash_size - 1);
+    if (pass && entry->key2 == entry->key) break;
+    while (tb_entries[index]) index = (index + 1) & (tb_hash_size - 1);
+    tb_entries[index] = entry;
+  }
+  if (entry->piece_count > tb_largest) tb_largest = entry->piece_count;
+}
+
+// free a tablebase's tables
+void
+tb_free_pairs(tb_pairs* d)
+{
+  free(d->base64);
+  free(d->symlen);
+}
+
+// (re)load the tablebases of all 3 to 5 men material signatures from the tablebase path
+void
+tb_init(char* path)
+{
+  for (int index = 0; index < tb_hash_size; index++) {                                                                 // forget the old tablebases
+    tb_entry* entry = tb_entries[index];
+    if (entry == NULL) continue;
+    for (int other = index; other < tb_hash_size; other++) if (tb_entries[other] == entry) tb_entries[other] = NULL;
+    for (int file = 0; file < 4; file++) {
+      tb_free_pairs(&entry->wdl[file][0]), tb_free_pairs(&entry->wdl[file][1]), tb_free_pairs(&entry->dtz[file]);
+    }
+    munmap(entry->wdl_file, entry->wdl_size);
+    if (entry->dtz_file) munmap(entry->dtz_file, entry->dtz_size);
+    free(entry);
+  }
+  tb_largest = 0;
+
+  strncpy(tb_path, path, sizeof(tb_path) - 1);
+  if (*tb_path == 0 || strcmp(tb_path, "<empty>") == 0) return;
+
+  char names[] = "QRBNP", name[16];
+  int found = 0;
+  for   (int p1 = 0; p1 < 5; p1++) {                                                                                   // pieces are named from the queen down
+    sprintf(name, "K%cvK", names[p1]), tb_add(name);
+    for (int p2 = p1; p2 < 5; p2++) {
+      sprintf(name, "K%c%cvK", names[p1], names[p2]), tb_add(name);
+      sprintf(name, "K%cvK%c", names[p1], names[p2]), tb_add(name);
+      for (int p3 = 0; p3 < 5; p3++)
+        sprintf(name, "K%c%cvK%c", names[p1], names[p2], names[p3]), tb_add(name);
+      for (int p3 = p2; p3 < 5; p3++) {
+        sprintf(name, "K%c%c%cvK", names[p1], names[p2], names[p3]), tb_add(name);
+      }
+    }
+  }
+  for (int index = 0; index < tb_hash_size; index++) found += tb_entries[index] != NULL;
+  printf("info string found %d tablebase keys, largest %d men\n", found, tb_largest);
+}
+
+
+// Search
+
+// These are the score bounds for the range of the mating scores
+// [-infinity, -mate_value ... -mate_score, ... score ... mate_score ...  mate_value, infinity]
+
+#define infinity   50000
+#define mate_value 49000
+#define mate_score 48000
+
+// most valuable victim & less valuable attacker
+
+//    (Victims) Pawn Knight Bishop   Rook  Queen   King
+//  (Attackers)
+//        Pawn   105    205    305    405    505    605
+//      Knight   104    204    304    404    504    604
+//      Bishop   103    203    303    403    503    603
+//        Rook   102    202    302    402    502    602
+//       Queen   101    201    301    401    501    601
+//        King   100    200    300    400    500    600
+
+// MVV LVA [attacker][victim]
+static int mvv_lva[12][12] = {
+  105, 205, 305, 405, 505, 605, 105, 205, 305, 405, 505, 605, 104, 204, 304,
+  404, 504, 604, 104, 204, 304, 404, 504, 604, 103, 203, 303, 403, 503, 603,
+  103, 203, 303, 403, 503, 603, 102, 202, 302, 402, 502, 602, 102, 202, 302,
+  402, 502, 602, 101, 201, 301, 401, 501, 601, 101, 201, 301, 401, 501, 601,
+  100, 200, 300, 400, 500, 600, 100, 200, 300, 400, 500, 600,
+
+  105, 205, 305, 405, 505, 605, 105, 205, 305, 405, 505, 605, 104, 204, 304,
+  404, 504, 604, 104, 204, 304, 404, 504, 604, 103, 203, 303, 403, 503, 603,
+  103, 203, 303, 403, 503, 603, 102, 202, 302, 402, 502, 602, 102, 202, 302,
+  402, 502, 602, 101, 201, 301, 401, 501, 601, 101, 201, 301, 401, 501, 601,
+  100, 200, 300, 400, 500, 600, 100, 200, 300, 400, 500, 600
+};
+
+#ifndef max_ply
+#define max_ply 128                                                                                                    /* max ply that we can reach within a search (override with -Dmax_ply=N) */
+#endif
+
+#define max_history 16384                                                                                              /* history scores are kept within [-max_history, max_history] */
+
+typedef struct                                                                                                         // move ordering statistics (kept from one search to the next)
+{
+  int         history_moves[12][64];                                                                                   // history moves [piece][square]
+  CompactMove counter_moves[12][64];                                                                                   // counter moves [previous move piece][previous move target square]
+  int         continuation_history[12][64][12][64];                                                                    // continuation history [previous piece][previous target][piece][target]
+} search_histories;
+
+_Thread_local int              engine;                                                                                 // engine searching on this thread (self-play matches: 0 test, 1 base)
+_Thread_local search_histories histories[2];                                                                           // histories of this thread's searches [engine]
+
+typedef struct                                                                                                         // search stack frame (one per ply)
+{
+  moves       move_list[1];                                                                                            // moves generated at the node
+  board_state undo;                                                                                                    // board state to take the moves of the node back
+  int         static_eval;                                                                                             // static evaluation of the node (no_static_eval when in check)
+  CompactMove killers[2];                                                                                              // killer moves
+  int         move;                                                                                                    // move leading to the node (0 for null move)
+  int         quiets_searched[64];                                                                                     // quiet moves searched without a cutoff (history malus candidates)
+  check_info  checks;                                                                                                  // check squares & discovered check candidates of the node
+} search_frame;
+
+_Thread_local search_frame search_stack[max_ply + 1];                                                                  // preallocated search stack [ply]
+_Thread_local int          root_depth;                                                                                 // depth of the current iterative deepening iteration
+_Thread_local CompactMove  excluded_root_moves[256];                                                                   // root moves skipped by the search (lines already found in MultiPV mode)
+_Thread_local int          excluded_root_count;                                                                        // number of excluded root moves
+_Thread_local int          search_moves[256];                                                                          // root moves the search is restricted to (UCI "go searchmoves")
+_Thread_local int          search_moves_count;                                                                         // number of root moves to search (0 = all moves)
+_Thread_local int          search_score;                                                                               // score of the last completed iteration
+_Thread_local int          search_depth;                                                                               // its depth
+_Thread_local int          search_move;                                                                                // & its best move (full move code, 0 if none)
+
+//      ================================
+//            Triangular PV table
+//      --------------------------------
+//        PV line: e2e4 e7e5 g1f3 b8c6
+//      ================================
+//
+//           0    1    2    3    4    5
+//
+//      0    m1   m2   m3   m4   m5   m6
+//
+//      1    0    m2   m3   m4   m5   m6
+//
+//      2    0    0    m3   m4   m5   m6
+//
+//      3    0    0    0    m4   m5   m6
+//
+//      4    0    0    0    0    m5   m6
+//
+//      5    0    0    0    0    0    m6
+
+_Thread_local int pv_length[max_ply + 1];                                                                              // PV length [ply]
+_Thread_local CompactMove pv_table[max_ply + 1][max_ply + 1];                                                          // PV table [ply][ply]
+_Thread_local int follow_pv, score_pv;                                                                                 // follow PV & score PV move
+
+// Transposition table
+#define hash_size       1250000                                                                                        /* hash table size (would be around 20MB) */
+#define no_hash_entry   100000                                                                                         /* no hash entry found constant */
+#define hash_flag_exact 0                                                                                              /* transposition table hash flags */
+#define hash_flag_alpha 1
+#define hash_flag_beta  2
+#define no_static_eval  32000                                                                                          /* static eval not available in hash entry */
+
+// pack hash entry fields into one 64-bit word: best move, static eval, flag, depth & score (offset to stay positive)
+#define tt_data(score, depth, flag, move, eval) \
+  ((U64)(CompactMove)(move) | (U64)(unsigned short)(eval) << 16 | (U64)(flag) << 32 | \
+   (U64)((depth) + 2048) << 34 | (U64)((score) + 131072) << 46)
+
+#define tt_move(data)   (CompactMove)(data)                                                                            /* extract hash entry fields */
+#define tt_eval(data)   (short)((data) >> 16)
+#define tt_flag(data)   (int)(((data) >> 32) & 3)
+#define tt_depth(data)  ((int)(((data) >> 34) & 4095) - 2048)
+#define tt_score(data)  ((int)((data) >> 46) - 131072)
+
+typedef struct                                                                                                         // transposition table data structure (16 bytes)
+{
+  U64 lock;                                                                                                            // hash key ^ data: an entry torn by a concurrent write of another thread fails the key check
+  U64 data;                                                                                                            // score, depth, flag, best move & static eval (see tt_data)
+} tt;                                                                                                                  // transposition table (TT aka hash table)
+
+tt  hash_table[hash_size];                                                                                             // define TT instance
+tt* hash_tables[2] = { hash_table, NULL };                                                                             // TT of each engine [engine] (the second one only exists during self-play matches)
+
+// clear TT (hash table)
+void
+clear_hash_table()
+{
+  for (int index = 0; index < hash_size; index++) {                                                                    // loop over TT elements
+    hash_table[index].data = tt_data(0, 0, 0, 0, no_static_eval);                                                      // reset TT inner fields
+    hash_table[index].lock = hash_table[index].data;                                                                   // (matching no real position)
+  }
+}
+
+// read hash entry data
+int
+read_hash_entry(int alpha, int beta, int depth, int* best_move, int* static_eval)
+{
+  tt* hash_entry = &hash_tables[engine][hash_key % hash_size];                                                         // create a TT instance pointer to particular hash entry storing
+                                                                                                                       // the scoring data for the current board position if available
+  U64 data = hash_entry->data;                                                                                         // read the entry word once
+
+  if ((hash_entry->lock ^ data) == hash_key) {                                                                         // make sure we're dealing with the exact position we need (and an untorn entry)
+    *best_move   = tt_move(data);                                                                                      // hash move is useful for move ordering at any depth
+    *static_eval = tt_eval(data);                                                                                      // and so is static eval for pruning decisions
+    if (tt_depth(data) >= depth) {                                                                                     // make sure that we match the exact depth our search is now at
+      int score = tt_score(data);                                                                                      // extract stored score from TT entry
+      if (score < -mate_score) score += ply;                                                                           // retrieve score independent from the actual path
+      if (score > mate_score)  score -= ply;                                                                           // from root node (position) to current node (position)
+      if (tt_flag(data)  == hash_flag_exact)                                                                           // match the exact (PV node) score
+        return score;                                                                                                  // return exact (PV node) score
+      if ((tt_flag(data) == hash_flag_alpha) && (score <= alpha))                                                      // match alpha (fail-low node) score
+        return alpha;                                                                                                  // return alpha (fail-low node) score
+      if ((tt_flag(data) == hash_flag_beta) && (score >= beta))                                                        // match beta (fail-high node) score
+        return beta;                                                                                                   // return beta (fail-high node) score
+    }
+  }
+  return no_hash_entry;                                                                                                // if hash entry doesn't exist
+}
+
+// write hash entry data
+void
+write_hash_entry(int score, int depth, int hash_flag, int best_move, int static_eval)
+{
+  tt* hash_entry = &hash_tables[engine][hash_key % hash_size];                                                         // create a TT instance pointer to particular hash entry storing
+                                                                                                                       // the scoring data for the current board position if available
+  if (score < -mate_score) score -= ply;                                                                               // store score independent from the actual path
+  if (score > mate_score)  score += ply;                                                                               // from root node (position) to current node (position)
+
+  if (ply == 0 && (excluded_root_count || search_moves_count)) return;                                                 // root results of a restricted move list are not the position's value
+
+  U64 data = hash_entry->data;
+  int same = (hash_entry->lock ^ data) == hash_key;                                                                    // entry holds the current position
+
+  if (same && depth < tt_depth(data) && hash_flag != hash_flag_exact)                                                  // don't let shallow bounds (e.g. quiescence) replace deeper results of the same position
+    return;
+
+  CompactMove move = compact_move(best_move);
+  if (best_move == 0 && same)              move        = tt_move(data);                                                // keep the old hash move on fail-low nodes of the same position
+  if (static_eval == no_static_eval && same) static_eval = tt_eval(data);                                              // keep the old static eval of the same position
+
+  data = tt_data(score, depth, hash_flag, move, static_eval);                                                          // write hash entry data
+  hash_entry->lock = hash_key ^ data;
+  hash_entry->data = data;
+}
+
+// enable PV move scoring
+void
+enable_pv_scoring(moves* move_list)
+{
+  follow_pv = 0;                                                                                                       // disable following PV
+
+  for (int count = 0; count < move_list->count; count++) {                                                             // loop over the moves within a move list
+    if (pv_table[0][ply] == compact_move(move_list->moves[count])) {                                                   // make sure we hit PV move
+      score_pv = 1;                                                                                                    // enable move scoring
+      follow_pv = 1;                                                                                                   // enable following PV
+    }
+  }
+}
+
+//  =======================
+//       Move ordering
+//  =======================
+//  1. PV move
+//  2. Hash move
+//  3. Captures in MVV/LVA
+//  4. 1st killer move
+//  5. 2nd killer move
+//  6. Counter move
+//  7. History & continuation history moves
+//  8. Unsorted moves
+
+// piece captured by the move (enpassant captures a pawn)
+int
+captured_piece(int move)
+{
+  int target_piece = (side == WHITE) ? p : P;                                                                          // init target piece (enpassant)
+  int start_piece, end_piece;                                                                                          // pick up bitboard piece index ranges depending on side
+
+  if (side == WHITE) {                                                                                                 // pick up side to move
+    start_piece = p;
+    end_piece = k;
+  } else {
+    start_piece = P;
+    end_piece = K;
+  }
+
+  for (int bb_piece = start_piece; bb_piece <= end_piece; bb_piece++) {                                                // loop over bitboards opposite to the current side to move
+    if (get_bit(bitboards[bb_piece], get_move_target(move))) {                                                         // if there's a piece on the target square
+      target_piece = bb_piece;
+      break;
+    }
+  }
+
+  return target_piece;
+}
+
+// history score of a quiet move: butterfly history plus 1 & 2 ply continuation history
+int
+quiet_history(int move)
+{
+  search_histories* history = &histories[engine];
+  int piece  = get_move_piece(move);
+  int target = get_move_target(move);
+  int score  = history->history_moves[piece][target];
+
+  for (int offset = 0; offset < 2 && offset <= ply; offset++) {                                                        // moves 1 and 2 plies back
+    int previous_move = search_stack[ply - offset].move;
+    if (previous_move)                                                                                                 // skip null moves & root
+      score += history->continuation_history[get_move_piece(previous_move)][get_move_target(previous_move)][piece][target];
+  }
+
+  return score;
+}
+
+// gravity history update: the closer the entry gets to max_history, the smaller the step, so scores stay bounded
+void
+update_history(int* entry, int bonus)
+{
+  *entry += bonus - *entry * abs(bonus) / max_history;
+}
+
+// reward a quiet move that caused a beta cutoff and punish the quiet moves searched before it
+void
+update_quiet_histories(int best_move, int depth, int* quiets, int quiet_count)
+{
+  search_histories* history = &histories[engine];
+  int bonus         = (depth * depth < 1200) ? depth * depth : 1200;                                                   // history bonus
+  int previous_move = search_stack[ply].move;                                                                          // move leading to the current node
+
+  if (previous_move)                                                                                                   // store counter move
+    history->counter_moves[get_move_piece(previous_move)][get_move_target(previous_move)] = compact_move(best_move);
+
+  for (int index = -1; index < quiet_count; index++) {                                                                 // best move first, then the quiet moves that failed to cut
+    int move   = (index < 0) ? best_move : quiets[index];
+    int delta  = (index < 0) ? bonus     : -bonus;
+    int piece  = get_move_piece(move);
+    int target = get_move_target(move);
+
+    update_history(&history->history_moves[piece][target], delta);
+
+    for (int offset = 0; offset < 2 && offset <= ply; offset++) {                                                      // 1 & 2 ply continuation history
+      int previous = search_stack[ply - offset].move;
+      if (previous)
+        update_history(&history->continuation_history[get_move_piece(previous)][get_move_target(previous)][piece][target], delta);
+    }
+  }
+}
+
+// score moves
+int
+score_move(int move)
+{
+  if (score_pv) {                                                                                                      // if PV move scoring is allowed
+    if (pv_table[0][ply] == compact_move(move)) {                                                                      // make sure we are dealing with PV move
+      score_pv = 0;                                                                                                    // disable score PV flag
+      return 20000;                                                                                                    // give PV move the highest score to search it first
+    }
+  }
+
+  if (get_move_capture(move))                                                                                          // score capture move
+    return mvv_lva[get_move_piece(move)][captured_piece(move)] + 10000;                                                // score move by MVV LVA lookup [source piece][target piece]
+
+  else {                                                                                                               // score quiet move
+    int previous_move = search_stack[ply].move;                                                                        // move leading to the current node
+
+    if      (search_stack[ply].killers[0] == compact_move(move)) return 9000;                                          // score 1st killer move
+    else if (search_stack[ply].killers[1] == compact_move(move)) return 8000;                                          // score 2nd killer move
+    else if (previous_move &&                                                                                          // score counter move
+             histories[engine].counter_moves[get_move_piece(previous_move)][get_move_target(previous_move)] == compact_move(move)) return 7000;
+    else                                   return quiet_history(move) / 8;                                             // score history move (stays within +/- 6144)
+  }
+
+  return 0;
+}
+
+// sort moves in descending order
+//
+// every move gets one 32-bit sort key: its score (fits 16 bits) above its index in the move list,
+// so sorting the keys drags the moves along without swapping parallel arrays
+void
+sort_moves(moves* move_list, int best_move)
+{
+  int keys[move_list->count];                                                                                          // move scores & move indices
+  int unsorted[move_list->count];                                                                                      // moves in generation order
+
+  for (int count = 0; count < move_list->count; count++) {                                                             // score all the moves within a move list
+    int score = score_move(move_list->moves[count]);                                                                   // score move
+    if (best_move && compact_move(move_list->moves[count]) == best_move && score < 15000)                              // score hash move right after the PV move
+      score = 15000;
+
+    int key    = score * 256 + (255 - count);                                                                          // equal scores keep generation order
+    int insert = count;
+    for (; insert > 0 && keys[insert - 1] < key; insert--)                                                             // insertion sort in descending order
+      keys[insert] = keys[insert - 1];
+    keys[insert]    = key;
+    unsorted[count] = move_list->moves[count];
+  }
+
+  for (int count = 0; count < move_list->count; count++)                                                               // put moves in sorted order
+    move_list->moves[count] = unsorted[255 - (keys[count] & 255)];
+}
+
+// print move scores
+void
+print_move_scores(moves* move_list)
+{
+  printf("     Move scores:\n\n");
+
+  for (int count = 0; count < move_list->count; count++) {                                                             // loop over moves within a move list
+    printf("     move: ");
+    print_move(move_list->moves[count]);
+    printf(" score: %d\n", score_move(move_list->moves[count]));
+  }
+}
+
+// position repetition detection
+//
+// repetition_table[repetition_index] holds the parent position, so the position k plies back is at
+// repetition_index - k + 1. Only positions with the same side to move (k even) since the last
+// irreversible move (k <= fifty) can repeat the current one.
+int
+is_repetition()
+{
+  int last = repetition_index - fifty + 1;                                                                             // oldest position after the last irreversible move
+  if (last < 1) last = 1;
+
+  for (int index = repetition_index - 1; index >= last; index -= 2)                                                    // loop over positions with the same side to move
+    if (repetition_table[index] == hash_key)                                                                           // if we found the hash key same with a current
+      return 1;                                                                                                        // we found a repetition
+
+  return 0;                                                                                                            // if no repetition found
+}
+
+//  Cuckoo tables for upcoming repetition detection
+//  (Marcel van Kervinck's algorithm as used in Stockfish)
+//
+//  Every reversible move of a non-pawn piece between two squares s1 & s2 changes the hash key by
+//  piece_keys[piece][s1] ^ piece_keys[piece][s2] ^ side_key. All 3668 such keys are stored in a
+//  cuckoo hash table, so XORing the current key with the key of a position an odd number of plies
+//  back tells in O(1) whether a single move would repeat that position.
+
+#define cuckoo_size        8192                                                                                        /* cuckoo table size (power of two) */
+#define cuckoo_h1(key)   (int)((key)        & (cuckoo_size - 1))                                                       /* first cuckoo hash function */
+#define cuckoo_h2(key)   (int)(((key) >> 16) & (cuckoo_size - 1))                                                      /* second cuckoo hash function */
+
+U64 cuckoo_keys[cuckoo_size];                                                                                          // move keys
+int cuckoo_moves[cuckoo_size];                                                                                         // moves (source | target << 6), 0 for empty slot
+
+// init cuckoo tables
+void
+init_cuckoo_tables()
+{
+  memset(cuckoo_keys,  0, sizeof(cuckoo_keys));
+  memset(cuckoo_moves, 0, sizeof(cuckoo_moves));
+
+  for (int piece = P; piece <= k; piece++) {                                                                           // loop over piece codes
+    if (piece == P || piece == p) continue;                                                                            // pawn moves are irreversible
+
+    for   (Square square1 = 0; square1 < 64; square1++) {
+      for (Square square2 = square1 + 1; square2 < 64; square2++) {
+        Bitboard attacks;                                                                                              // attacks on an empty board
+
+        switch (piece % 6) {
+          case N:  attacks = knight_attacks[square1];                                  break;
+          case B:  attacks = bishop_attacks_on_the_fly(square1, 0ULL);                 break;
+          case R:  attacks = rook_attacks_on_the_fly(square1, 0ULL);                   break;
+          case Q:  attacks = bishop_attacks_on_the_fly(square1, 0ULL) |
+                             rook_attacks_on_the_fly(square1, 0ULL);                   break;
+          default: attacks = king_attacks[square1];                                    break;
+        }
+
+        if (!get_bit(attacks, square2)) continue;                                                                      // the piece can't move between the squares
+
+        U64 key  = piece_keys[piece][square1] ^ piece_keys[piece][square2] ^ side_key;                                 // move key
+        int move = square1 | (square2 << 6);
+        int slot = cuckoo_h1(key);
+
+        while (1) {                                                                                                    // cuckoo insertion
+          U64 temp_key  = cuckoo_keys[slot];                                                                           // swap the entry in the slot with the one we insert
+          int temp_move = cuckoo_moves[slot];
+          cuckoo_keys[slot]  = key;
+          cuckoo_moves[slot] = move;
+          key  = temp_key;
+          move = temp_move;
+          if (move == 0) break;                                                                                        // slot was empty
+          slot = (slot == cuckoo_h1(key)) ? cuckoo_h2(key) : cuckoo_h1(key);                                           // push evicted entry into its other slot
+        }
+      }
+    }
+  }
+}
+
+// can the side to move repeat a position of the current search line with a single move
+int
+has_game_cycle()
+{
+  if (fifty < 3) return 0;                                                                                             // no reversible move sequence long enough
+
+  for (int plies_back = 3; plies_back <= fifty && plies_back <= ply; plies_back += 2) {                                // positions within the search tree, opponent to move
+    U64 move_key = hash_key ^ repetition_table[repetition_index - plies_back + 1];                                     // key difference to that position
+    int slot     = cuckoo_h1(move_key);
+
+    if (cuckoo_keys[slot] != move_key) slot = cuckoo_h2(move_key);
+    if (cuckoo_keys[slot] != move_key) continue;                                                                       // no single move makes up the difference
+
+    int move = cuckoo_moves[slot];
+    if ((between_squares[move & 0x3f][move >> 6] & occupancies[BOTH]) == 0)                                            // the move isn't blocked
+      return 1;
+  }
+
+  return 0;
+}
+
+// make sure repetition table can hold the game history plus the longest search line
+void
+grow_repetition_table()
+{
+  if (repetition_index + max_ply + 2 < repetition_size) return;                                                        // still enough room
+
+  repetition_size  = repetition_size ? repetition_size * 2 : 1024;                                                     // double the capacity
+  repetition_table = realloc(repetition_table, repetition_size * sizeof(U64));
+
+  if (repetition_table == NULL) {                                                                                      // out of memory
+    printf("  Failed to allocate repetition table!\n");
+    exit(1);
+  }
+}
+
+// search parameters (tunable via UCI "setoption")
+typedef struct
+{
+  int rfp_depth;                                                                                                       // reverse futility pruning (static null move) depth limit
+  int rfp_margin;                                                                                                      // reverse futility pruning margin per ply
+  int razor_depth;                                                                                                     // razoring depth limit
+  int razor_margin;                                                                                                    // razoring margin per ply
+  int futility_depth;                                                                                                  // futility pruning depth limit
+  int futility_margin;                                                                                                 // futility pruning margin per ply
+  int lmp_depth;                                                                                                       // late move pruning depth limit
+  int lmp_base;                                                                                                        // late move pruning skips quiet moves after (lmp_base + depth * depth) moves searched
+  int nmp_depth;                                                                                                       // null move pruning depth limit
+  int nmp_base;                                                                                                        // null move base reduction
+  int nmp_depth_divisor;                                                                                               // null move reduction grows by one ply every nmp_depth_divisor plies of depth
+  int nmp_eval_divisor;                                                                                                // null move reduction grows by one ply every nmp_eval_divisor of static eval over beta (max 3)
+  int nmp_verify_depth;                                                                                                // depth at which null move cutoffs are verified by a reduced search without null moves
+  int delta_margin;                                                                                                    // quiescence delta pruning safety margin
+  int iir_depth;                                                                                                       // internal iterative reduction depth limit
+  int lmr_base;                                                                                                        // late move reduction base (in 1/100 ply)
+  int lmr_divisor;                                                                                                     // late move reduction log(depth) * log(moves) divisor (in 1/100)
+  int lmr_table[max_ply][64];                                                                                          // late move reductions [depth][moves searched] (derived from lmr_base & lmr_divisor)
+} search_parameters;
+
+search_parameters default_parameters = {                                                                               // UCI "setoption" values
+  .rfp_depth         =   3,
+  .rfp_margin        = 120,
+  .razor_depth       =   2,
+  .razor_margin      = 200,
+  .futility_depth    =   3,
+  .futility_margin   = 100,
+  .lmp_depth         =   3,
+  .lmp_base          =   4,
+  .nmp_depth         =   3,
+  .nmp_base          =   2,
+  .nmp_depth_divisor =   4,
+  .nmp_eval_divisor  = 200,
+  .nmp_verify_depth  =  10,
+  .delta_margin      = 200,
+  .iir_depth         =   4,
+  .lmr_base          =  75,
+  .lmr_divisor       = 225
+};
+_Thread_local search_parameters* parameters = &default_parameters;                                                     // parameters of this thread's searches (self-play matches switch them per move)
+
+// quiescence search
+int
+quiescence(int alpha, int beta)
+{
+  if ((nodes & 2047) == 0) communicate();                                                                              // every 2047 nodes; "listen" to the GUI/user input
+  nodes++;
+  if (ply > max_ply - 1) return evaluate();                                                                            // we are too deep, hence there's an overflow of arrays relying on max ply constant
+
+  int pv_node     = beta - alpha > 1;                                                                                  // PV node (position)
+  int hash_move   = 0;                                                                                                 // best move stored in TT for this position
+  int best_move   = 0;                                                                                                 // best move found by this search
+  int static_eval = no_static_eval;                                                                                    // static eval stored in TT for this position
+  int exact_eval  = 1;                                                                                                 // static eval is exact (not a lazy bound)
+  int hash_flag   = hash_flag_alpha;                                                                                   // define hash flag
+  int score       = read_hash_entry(alpha, beta, 0, &hash_move, &static_eval);                                         // any hash entry is at least as deep as quiescence
+
+  if (score != no_hash_entry && pv_node == 0) return score;                                                            // reuse stored score
+
+  int in_check = is_square_attacked((side == WHITE) ? get_ls1b_index(bitboards[K])                                     // is king in check
+                                                    : get_ls1b_index(bitboards[k]), side ^ 1);
+
+  if (in_check == 0) {                                                                                                 // stand pat (not allowed when in check)
+    if (static_eval == no_static_eval) {                                                                               // evaluate position unless TT has done it for us
+      static_eval = cached_evaluate(alpha, beta);
+      exact_eval  = lazy_exit == 0;
+    }
+    if (static_eval >= beta) {                                                                                         // fail-hard beta cutoff; node (position) fails high
+      write_hash_entry(beta, 0, hash_flag_beta, 0, exact_eval ? static_eval : no_static_eval);                         // cache stand pat cutoff & static eval
+      return beta;
+    }
+    if (static_eval + material_score[Q] + parameters->delta_margin <= alpha)                                           // delta pruning: even winning a queen can't raise alpha
+      return alpha;
+    if (static_eval > alpha) {                                                                                         // found a better move; PV node (position)
+      alpha     = static_eval;
+      hash_flag = hash_flag_exact;
+    }
+  }
+
+  moves* move_list = search_stack[ply].move_list;                                                                      // move list of the current search stack frame
+  generate_moves(move_list);                                                                                           // generate moves
+
+  if (in_check == 0) {                                                                                                 // not in check: search only captures
+    int captures = 0;
+    for (int count = 0; count < move_list->count; count++)                                                             // drop quiet moves before sorting
+      if (get_move_capture(move_list->moves[count]))
+        move_list->moves[captures++] = move_list->moves[count];
+    move_list->count = captures;
+  }
+
+  sort_moves(move_list, hash_move);                                                                                    // sort moves
+  int legal_moves = 0;                                                                                                 // legal moves counter
+
+  for (int count = 0; count < move_list->count; count++) {                                                             // loop over moves within a movelist
+    int move = move_list->moves[count];
+
+    if (in_check == 0 && get_move_promoted(move) == 0 &&                                                               // delta pruning: captured material plus a safety margin
+        static_eval + material_score[captured_piece(move) % 6] + parameters->delta_margin <= alpha)                    // can't raise alpha
+      continue;
+
+    save_board(&search_stack[ply].undo);                                                                               // preserve board state
+    ply++;
+    repetition_index++;                                                                                                // increment repetition index & store hash key
+    repetition_table[repetition_index] = hash_key;
+    search_stack[ply].move = move;
+    if (make_move(move, all_moves) == 0) {                                                                             // make sure to make only legal moves
+      ply--;
+      repetition_index--;
+      continue;                                                                                                        // skip to next move
+    }
+    legal_moves++;
+    score = -quiescence(-beta, -alpha);                                                                                // score current move
+    ply--;
+    repetition_index--;
+    restore_board(&search_stack[ply].undo);                                                                            // take move back
+    if (stopped == 1) return 0;                                                                                        // return 0 if time is up
+    if (score > alpha) {                                                                                               // found a better move
+      alpha     = score;                                                                                               // PV node (position)
+      best_move = move;
+      hash_flag = hash_flag_exact;
+      if (score >= beta) {                                                                                             // fail-hard beta cutoff; node (position) fails high
+        write_hash_entry(beta, 0, hash_flag_beta, best_move, exact_eval ? static_eval : no_static_eval);
+        return beta;
+      }
+    }
+  }
+
+  if (in_check && legal_moves == 0)                                                                                    // no evasions: checkmate
+    return -mate_value + ply;
+
+  write_hash_entry(alpha, 0, hash_flag, best_move, exact_eval ? static_eval : no_static_eval);                         // store hash entry with the score equal to alpha
+  return alpha;                                                                                                        // node (position) fails low
+}
+
+const int full_depth_moves = 4;                                                                                        // full depth moves counter
+const int reduction_limit  = 3;                                                                                        // depth limit to consider reduction
+
+_Thread_local int nmp_min_ply = 0;                                                                                     // null move pruning is disabled below this ply during verification search
+
+// non-pawn material (knights, bishops, rooks & queens) of the given side
+U64
+non_pawn_material(int side)
+{
+  return (side == WHITE) ? bitboards[N] | bitboards[B] | bitboards[R] | bitboards[Q]
+                         : bitboards[n] | bitboards[b] | bitboards[r] | bitboards[q];
+}
+
+// natural logarithm scaled by 1024 (fixed point, so we don't need to link libm)
+int
+log_x1024(int x)
+{
+  int result = 0;                                                                                                      // log2(x) scaled by 1024
+  int msb    = 0;                                                                                                      // most significant bit index
+
+  while ((x >> (msb + 1)) > 0) msb++;                                                                                  // integer part of log2(x)
+  U64 y = ((U64)x << 16) >> msb;                                                                                       // normalize x into [1, 2) as 16.16 fixed point
+
+  for (int bit = 9; bit >= 0; bit--) {                                                                                 // binary digits of the fractional part
+    y = (y * y) >> 16;                                                                                                 // square the mantissa
+    if (y >= (2ULL << 16)) {                                                                                           // mantissa overflowed 2
+      y >>= 1;                                                                                                         // renormalize it
+      result |= 1 << bit;                                                                                              // and set the current fractional bit
+    }
+  }
+  result += msb << 10;
+
+  return result * 710 / 1024;                                                                                          // ln(x) = log2(x) * ln(2)
+}
+
+// init late move reduction table of the current search parameters
+void
+init_lmr_table()
+{
+  for   (int depth = 1; depth < max_ply; depth++) {
+    for (int count = 1; count < 64;     count++) {
+      int reduction = parameters->lmr_base * 1024 * 1024 / 100 +                                                       // R = base + ln(depth) * ln(moves) / divisor
+                      log_x1024(depth) * log_x1024(count) / parameters->lmr_divisor * 100;
+      parameters->lmr_table[depth][count] = reduction / (1024 * 1024);
+    }
+  }
+}
+
+// is the move left out of the root move list (line already found or not among "searchmoves")
+int
+is_skipped_root_move(int move)
+{
+  for (int index = 0; index < excluded_root_count; index++)
+    if (excluded_root_moves[index] == compact_move(move)) return 1;
+
+  if (search_moves_count == 0) return 0;
+  for (int index = 0; index < search_moves_count; index++)
+    if (search_moves[index] == move) return 0;
+  return 1;
+}
+
+// negamax alpha beta search
+int
+negamax(int alpha, int beta, int depth)
+{
+  int score;                                                                                                           // variable to store current move's score (from the static evaluation perspective)
+  int hash_flag = hash_flag_alpha;                                                                                     // define hash flag
+
+  if (ply > max_ply - 1) return evaluate();                                                                            // we are too deep, hence there's an overflow of arrays relying on max ply constant
+  pv_length[ply] = ply;                                                                                                // init PV length
+
+  if (ply && (fifty >= 100 || is_repetition())) return 0;                                                              // if position repetition or fifty move rule occurs return draw score
+  if (ply && is_endgame_draw(probe_material())) return 0;                                                              // so does a recognized drawn endgame
+
+  int pv_node = beta - alpha > 1;                                                                                      // a hack by Pedro Castro to figure out whether the current node is PV node or not
+
+  if (ply && alpha < 0 && has_game_cycle()) {                                                                          // we can repeat a position of the search line with one move
+    alpha = 0;                                                                                                         // so at least a draw is guaranteed
+    if (alpha >= beta) return alpha;
+  }
+
+  int hash_move = 0;                                                                                                   // best move stored in TT for this position
+  int best_move = 0;                                                                                                   // best move found by this search
+
+  int static_eval = no_static_eval;                                                                                    // static evaluation of the current node
+
+  score = read_hash_entry(alpha, beta, depth, &hash_move, &static_eval);                                               // read hash entry
+  if (ply && score != no_hash_entry && pv_node == 0) return score;                                                     // if we're not in a root ply and hash entry is available and current node is not a PV node
+                                                                                                                       // if the move has already been searched we just return the score for this move without searching it
+  if ((nodes & 2047) == 0) communicate();                                                                              // every 2047 nodes "listen" to the GUI/user input
+
+  if (ply && tb_largest && castle == 0 && fifty == 0 && count_bits(occupancies[BOTH]) <= tb_probe_limit) {             // tablebase position (right after a capture or pawn move)
+    int result, wdl = tb_probe_wdl(&result);
+    if (result != tb_fail) {
+      tb_hits++;
+      return (wdl < -1) ? -tb_win_score + ply : (wdl > 1) ? tb_win_score - ply : 0;                                    // 50 move rule draws are draws
+    }
+  }
+
+  if (depth <= 0)        return quiescence(alpha, beta);                                                               // run quiescence search
+
+  nodes++;
+
+  int in_check = is_square_attacked((side == WHITE) ? get_ls1b_index(bitboards[K])                                     // is king in check
+                                                    : get_ls1b_index(bitboards[k]), side ^ 1);
+
+  if (in_check && ply < 2 * root_depth) depth++;                                                                       // increase search depth if the king has been exposed into a check (within reason)
+  int legal_moves = 0;                                                                                                 // legal moves counter
+  int futility    = 0;                                                                                                 // futility pruning flag for quiet moves
+
+  if (in_check == 0 && static_eval == no_static_eval)                                                                  // evaluate position unless TT has done it for us
+    static_eval = cached_evaluate(-infinity, infinity);                                                                // pruning margins need the exact score
+  if (in_check)
+    static_eval = no_static_eval;
+  search_stack[ply].static_eval = static_eval;
+
+  int improving = ply >= 2 && in_check == 0 &&                                                                         // static eval got better since our previous move
+                  search_stack[ply - 2].static_eval != no_static_eval &&
+                  static_eval > search_stack[ply - 2].static_eval;
+
+  if (pv_node == 0 && in_check == 0) {                                                                                 // static evaluation based pruning at shallow depths
+
+    if (depth <= parameters->rfp_depth && abs(beta) < mate_score &&                                                    // reverse futility pruning (static null move pruning)
+        static_eval - parameters->rfp_margin * (depth - improving) >= beta)
+      return beta;                                                                                                     // static eval beats beta by a margin; node (position) fails high
+
+    if (depth <= parameters->razor_depth && static_eval + parameters->razor_margin * depth <= alpha) {                 // razoring
+      score = quiescence(alpha, beta);                                                                                 // verify that tactics don't rescue the node
+      if (stopped == 1)    return 0;                                                                                   // return 0 if time is up
+      if (score <= alpha)  return alpha;                                                                               // node (position) fails low
+    }
+
+    futility = depth <= parameters->futility_depth && abs(alpha) < mate_score &&                                       // quiet moves can't raise alpha
+               static_eval + parameters->futility_margin * depth <= alpha;
+  }
+
+  if (depth >= parameters->nmp_depth && in_check == 0 && pv_node == 0 && ply && ply >= nmp_min_ply &&                  // null move pruning
+      static_eval >= beta && abs(beta) < mate_score &&
+      non_pawn_material(side)) {                                                                                       // don't trust null move in zugzwang prone pawn endgames
+    int reduction = parameters->nmp_base + depth / parameters->nmp_depth_divisor;                                      // reduction grows with depth
+    int eval_gain = (static_eval - beta) / parameters->nmp_eval_divisor;                                               // and with the static eval margin over beta
+    reduction    += (eval_gain < 3) ? eval_gain : 3;
+    if (reduction > depth - 1) reduction = depth - 1;
+
+    save_board(&search_stack[ply].undo);                                                                               // preserve board state
+    ply++;
+    repetition_index++;                                                                                                // increment repetition index & store hash key
+    repetition_table[repetition_index] = hash_key;
+    search_stack[ply].move = 0;                                                                                        // null move
+    fifty           = 0;                                                                                               // positions before the null move can't repeat in its subtree
+    if (enpassant != no_sq) hash_key ^= enpassant_keys[enpassant];                                                     // hash enpassant if available
+    enpassant  = no_sq;                                                                                                // reset enpassant capture square
+    side      ^= 1;                                                                                                    // switch the side, literally giving opponent an extra move to make
+    hash_key  ^= side_key;                                                                                             // hash the side
+    score      = -negamax(-beta, -beta + 1, depth - 1 - reduction);                                                    // search moves with reduced depth to find beta cutoffs depth - 1 - R where R is a reduction limit
+    ply--;
+    repetition_index--;                                                                                                // decrement repetition index
+    restore_board(&search_stack[ply].undo);                                                                            // restore board state
+    if (stopped == 1)    return 0;                                                                                     // return 0 if time is up
+
+    if (score >= beta) {
+      if (depth < parameters->nmp_verify_depth || nmp_min_ply) return beta;                                            // fail-hard beta cutoff node (position) fails high
+
+      nmp_min_ply = ply + 3 * (depth - 1 - reduction) / 4;                                                             // verification search: no null moves in the upper part of its tree
+      score       = negamax(beta - 1, beta, depth - 1 - reduction);                                                    // search the current position itself with the reduced depth
+      nmp_min_ply = 0;
+      if (stopped == 1)    return 0;                                                                                   // return 0 if time is up
+      if (score   >= beta) return beta;                                                                                // null move cutoff verified
+    }
+  }
+  if (ply && hash_move == 0 && depth >= parameters->iir_depth)                                                         // internal iterative reduction: without a hash move ordering is poor,
+    depth--;                                                                                                           // so search the node shallower; the next iteration will find a hash move
+
+  search_frame* frame     = &search_stack[ply];                                                                        // search stack frame of the current node
+  moves*        move_list = frame->move_list;                                                                          // move list of the current node
+  generate_moves(move_list);                                                                                           // generate moves
+  if (follow_pv) enable_pv_scoring(move_list);                                                                         // if we are now following PV line enable PV move scoring
+  sort_moves(move_list, hash_move);                                                                                    // sort moves
+  init_check_info(&frame->checks);                                                                                     // prepare check detection for the moves of the node
+  int moves_searched = 0;                                                                                              // number of moves searched in a move list
+  int quiet_count    = 0;                                                                                              // number of quiet moves searched so far
+
+  for (int count = 0; count < move_list->count; count++) {                                                             // loop over moves within a movelist
+    if (ply == 0 && is_skipped_root_move(move_list->moves[count])) continue;                                           // skip root moves we are not asked to search
+
+    int quiet    = get_move_capture(move_list->moves[count]) == 0 &&                                                   // quiet move (neither capture nor promotion)
+                   get_move_promoted(move_list->moves[count]) == 0;
+    int checking = gives_check(move_list->moves[count], &frame->checks);                                               // does the move give check
+
+    if (moves_searched && quiet && checking == 0 && pv_node == 0 && in_check == 0 &&                                   // prune late quiet moves at shallow depths before making them
+        (futility ||                                                                                                   // futility pruning
+         (depth <= parameters->lmp_depth && moves_searched >= parameters->lmp_base + depth * depth)))                  // late move pruning (move count based)
+      continue;                                                                                                        // skip to next move
+
+    save_board(&frame->undo);                                                                                          // preserve board state
+    ply++;
+    repetition_index++;                                                                                                // increment repetition index & store hash key
+    repetition_table[repetition_index] = hash_key;
+    search_stack[ply].move = move_list->moves[count];                                                                  // remember the move for continuation history
+
+    if (make_move(move_list->moves[count], all_moves) == 0) {                                                          // make sure to make only legal moves
+      ply--;
+      repetition_index--;
+      continue;                                                                                                        // skip to next move
+    }
+    legal_moves++;
+
+    if (moves_searched == 0) score = -negamax(-beta, -alpha, depth - 1);                                               // full depth search do normal alpha beta search
+    else {                                                                                                             // late move reduction (LMR)
+      if (moves_searched >= full_depth_moves && depth >= reduction_limit &&                                            // condition to consider LMR
+          in_check == 0 && checking == 0 && quiet) {
+        int reduction = parameters->lmr_table[depth < max_ply ? depth : max_ply - 1]                                   // log based reduction [depth][moves searched]
+                                 [moves_searched < 64 ? moves_searched : 63];
+        if (pv_node && reduction > 0) reduction--;                                                                     // reduce PV nodes less
+        if (reduction < 1)            reduction = 1;                                                                   // reduce at least one ply
+        if (reduction > depth - 2)    reduction = depth - 2;                                                           // but don't drop into quiescence
+        score = -negamax(-alpha - 1, -alpha, depth - 1 - reduction);                                                   // search current move with reduced depth:
+      }
+      else                                                                                                             // hack to ensure that full-depth search is done
+        score = alpha + 1;
+
+      if (score > alpha) {                                                                                             // principle variation search PVS
+        score = -negamax(-alpha - 1, -alpha, depth - 1);                                                               // Once you've found a move with a score that is between alpha and beta,
+                                                                                                                       // the rest of the moves are searched with the goal of proving that they
+                                                                                                                       // are all bad. It's possible to do this a bit faster than a search that
+                                                                                                                       // worries that one of the remaining moves might be good.
+
+        if ((score > alpha) && (score < beta))                                                                         // If the algorithm finds out that it was wrong, and that one of the
+                                                                                                                       // subsequent moves was better than the first PV move, it has to search
+                                                                                                                       // again, in the normal alpha-beta manner.  This happens sometimes, and
+                                                                                                                       // it's a waste of time, but generally not often enough to counteract
+                                                                                                                       // the savings gained from doing the "bad move proof" search referred to earlier.
+          score = -negamax(-beta, -alpha, depth - 1);                                                                  // re-search the move that has failed to be proved to be bad with normal alpha beta score bounds
+      }
+    }
+
+    ply--;
+    repetition_index--;
+    restore_board(&frame->undo);                                                                                       // take move back
+
+    if (stopped == 1) return 0;                                                                                        // return 0 if time is up
+
+    moves_searched++;                                                                                                  // increment the counter of moves searched so far
+
+    if (score > alpha) { 
+      hash_flag = hash_flag_exact;                                                                                     // found a better move switch hash flag from storing score for fail-low node to the one storing score for PV node
+
+      alpha     = score;                                                                                               // PV node (position)
+      best_move = move_list->moves[count];                                                                             // remember best move for the TT
+      pv_table[ply][ply] = compact_move(move_list->moves[count]);                                                      // write PV move
+
+      for (int next_ply = ply + 1; next_ply < pv_length[ply + 1]; next_ply++)                                          // loop over the next ply
+        pv_table[ply][next_ply] = pv_table[ply + 1][next_ply];                                                         // copy move from deeper ply into a current ply's line
+
+      pv_length[ply] = pv_length[ply + 1];                                                                             // adjust PV length
+
+      if (score >= beta) {                                                                                             // fail-hard beta cutoff
+        write_hash_entry(beta, depth, hash_flag_beta, best_move, static_eval);                                         // store hash entry with the score equal to beta
+
+        if (quiet) {                                                                                                   // on quiet moves
+          frame->killers[1] = frame->killers[0];                                                                       // store killer moves
+          frame->killers[0] = compact_move(move_list->moves[count]);
+          update_quiet_histories(move_list->moves[count], depth, frame->quiets_searched, quiet_count);                 // store history, continuation history & counter moves
+        }
+        return beta;                                                                                                   // node (position) fails high
+      }
+    }
+
+    if (quiet && quiet_count < 64)                                                                                     // quiet move failed to produce a cutoff
+      frame->quiets_searched[quiet_count++] = move_list->moves[count];
+  }
+
+  if (legal_moves == 0) {                                                                                              // we don't have any legal moves to make in the current postion
+    if (in_check)                                                                                                      // king is in check
+      return -mate_value + ply;                                                                                        // return mating score (assuming closest distance to mating position)
+    else                                                                                                               // king is not in check
+      return 0;                                                                                                        // return stalemate score
+  }
+
+  write_hash_entry(alpha, depth, hash_flag, best_move, static_eval);                                                   // store hash entry with the score equal to alpha
+  return alpha;                                                                                                        // node (position) fails low
+}
+
+// halve history & continuation history scores
+void
+age_histories()
+{
+  int* entry = &histories[engine].history_moves[0][0];
+  for (int index = 0; index < 12 * 64; index++) entry[index] /= 2;
+
+  entry = &histories[engine].continuation_history[0][0][0][0];
+  for (int index = 0; index < 12 * 64 * 12 * 64; index++) entry[index] /= 2;
+}
+
+// print the "info" line of a search result (line > 0 adds the MultiPV rank)
+void
+print_search_info(int score, int depth, int line, CompactMove* pv, int length)
+{
+  if (verbose == 0) return;
+  printf("info ");
+  if (line) printf("multipv %d ", line);
+  if      (score > -mate_value && score < -mate_score) printf("score mate %d depth %d nodes %lld tbhits %lld time %d pv ", -(score + mate_value) / 2 - 1, depth, nodes, tb_hits, get_time_ms() - starttime);
+  else if (score >  mate_score && score <  mate_value) printf("score mate %d depth %d nodes %lld tbhits %lld time %d pv ",  (mate_value - score) / 2 + 1, depth, nodes, tb_hits, get_time_ms() - starttime);
+  else                                                 printf("score cp %d depth %d nodes %lld tbhits %lld time %d pv ",    score, depth, nodes, tb_hits, get_time_ms() - starttime);
+
+  for (int count = 0; count < length; count++) {                                                                       // loop over the moves within a PV line
+    print_move(expand_move(pv[count]));                                                                                // print PV move
+    printf(" ");
+  }
+  printf("\n");
+}
+
+#define max_multi_pv 64                                                                                                /* max number of lines in MultiPV mode */
+
+int multi_pv = 1;                                                                                                      // number of lines to search (UCI "MultiPV")
+_Thread_local CompactMove multi_pv_moves[max_multi_pv][max_ply + 1];                                                   // best lines of the last completed iteration [line][ply]
+_Thread_local int multi_pv_lengths[max_multi_pv];                                                                      // their lengths [line]
+_Thread_local int multi_pv_scores[max_multi_pv];                                                                       // their scores [line]
+_Thread_local int multi_pv_count;                                                                                      // number of lines found
+
+// search the root once per line, each time excluding the first moves of the lines found before
+void
+search_multi_pv(int depth)
+{
+  CompactMove moves[max_multi_pv][max_ply + 1];                                                                        // lines of this iteration
+  int lengths[max_multi_pv];
+  int scores[max_multi_pv];
+  int count = 0;
+
+  excluded_root_count = 0;
+  for (int line = 0; line < multi_pv; line++) {
+    if (line < multi_pv_count) {                                                                                       // follow the line of the previous iteration
+      memcpy(pv_table[0], multi_pv_moves[line], sizeof(multi_pv_moves[line]));
+      pv_length[0] = multi_pv_lengths[line];
+    }
+    else
+      pv_length[0] = 0;
+
+    follow_pv = 1;
+    int score = negamax(-infinity, infinity, depth);                                                                   // full window: every line needs an exact score
+
+    if (stopped == 1) break;                                                                                           // keep the lines of the previous iteration
+    if (pv_length[0] == 0) break;                                                                                      // no root moves left
+
+    memcpy(moves[count], pv_table[0], sizeof(moves[count]));
+    lengths[count] = pv_length[0];
+    scores[count]  = score;
+    count++;
+    excluded_root_moves[excluded_root_count++] = pv_table[0][0];
+  }
+  excluded_root_count = 0;
+
+  if (stopped == 0) {
+    for (int line = 0; line < count; line++) {                                                                         // rank lines by score (insertion sort)
+      int insert = line;
+      while (insert && multi_pv_scores[insert - 1] < scores[line]) insert--;
+      for (int index = line; index > insert; index--) {
+        memcpy(multi_pv_moves[index], multi_pv_moves[index - 1], sizeof(multi_pv_moves[index]));
+        multi_pv_lengths[index] = multi_pv_lengths[index - 1];
+        multi_pv_scores[index]  = multi_pv_scores[index - 1];
+      }
+      memcpy(multi_pv_moves[insert], moves[line], sizeof(moves[line]));
+      multi_pv_lengths[insert] = lengths[line];
+      multi_pv_scores[insert]  = scores[line];
+    }
+    multi_pv_count = count;
+
+    for (int line = 0; line < multi_pv_count; line++)                                                                  // print search info of every line
+      print_search_info(multi_pv_scores[line], depth, line + 1, multi_pv_moves[line], multi_pv_lengths[line]);
+  }
+
+  if (multi_pv_count) {                                                                                                // best line decides the best move
+    memcpy(pv_table[0], multi_pv_moves[0], sizeof(multi_pv_moves[0]));
+    pv_length[0] = multi_pv_lengths[0];
+  }
+}
+
+// move of the root position a compact move stands for (0 if none)
+int
+root_move(CompactMove move)
+{
+  moves move_list[1];
+  generate_moves(move_list);
+  for (int count = 0; count < move_list->count; count++)
+    if (compact_move(move_list->moves[count]) == move) return move_list->moves[count];
+  return 0;
+}
+
+// search position for the best move
+void
+search_position(int depth)
+{
+  int score    = 0;                                                                                                    // define best score variable
+  nodes        = 0;                                                                                                    // reset nodes counter
+  stopped      = 0;                                                                                                    // reset "time is up" flag
+  stop_request = __atomic_load_n(&stop_requests, __ATOMIC_RELAXED);                                                    // only later bbc_stop() calls stop this search
+  follow_pv    = 0;                                                                                                    // reset follow PV flags
+  score_pv     = 0;
+
+  eval_cache_probes = 0;                                                                                               // reset eval cache statistics
+  eval_cache_hits   = 0;
+  lazy_evals        = 0;                                                                                               // reset lazy eval statistics
+  lazy_exits_high   = 0;
+  lazy_exits_low    = 0;
+
+  nnue_ply = 0;                                                                                                        // search line starts at the first NNUE accumulator
+  if (use_nnue) nnue_refresh();
+
+  memset(search_stack,  0, sizeof(search_stack));                                                                      // clear helper data structures for search
+  age_histories();                                                                                                     // keep history from previous searches, but let it decay
+  memset(pv_table,      0, sizeof(pv_table));
+  memset(pv_length,     0, sizeof(pv_length));
+
+  int alpha = -infinity;                                                                                               // define initial alpha beta bounds
+  int beta  = infinity;
+  multi_pv_count = 0;
+  tb_hits        = 0;
+  search_score   = 0;
+  search_depth   = 0;
+  search_move    = 0;
+
+  if (search_moves_count == 0)                                                                                         // tablebase root position: search only the moves keeping its result
+    search_moves_count = tb_root_moves(search_moves);
+
+  for (int current_depth = 1; current_depth <= depth; current_depth++) {                                               // iterative deepening
+    if (stopped == 1)                                                                                                  // if time is up
+      break;                                                                                                           // stop calculating and return best move so far
+
+    root_depth = current_depth;                                                                                        // remember iteration depth (limits check extensions)
+
+    if (multi_pv > 1) {                                                                                                // search several lines
+      search_multi_pv(current_depth);
+      if (stopped == 0 && multi_pv_count)
+        search_score = multi_pv_scores[0], search_depth = current_depth, search_move = root_move(multi_pv_moves[0][0]);
+      continue;
+    }
+
+    follow_pv = 1;                                                                                                     // enable follow PV flag
+    score = negamax(alpha, beta, current_depth);                                                                       // find best move within a given position
+
+    if ((score <= alpha) || (score >= beta)) {                                                                         // we fell outside the window, so try again with a full-width window (and the same depth)
+      alpha = -infinity;
+      beta  =  infinity;
+      continue;
+    }
+
+    // set up the window for the next iteration
+    alpha = score - 50;
+    beta  = score + 50;
+
+    print_search_info(score, current_depth, 0, pv_table[0], pv_length[0]);                                             // print search info
+    if (stopped == 0)                                                                                                  // an interrupted iteration keeps the previous result
+      search_score = score, search_depth = current_depth, search_move = pv_length[0] ? root_move(pv_table[0][0]) : 0;
+  }
+
+  search_moves_count = 0;                                                                                              // restrictions only hold for this search (bench, match games)
+  stopnodes          = 0;
+  if (verbose == 0) return;
+
+  printf("info string eval cache hits %lld of %lld probes (%lld%%)\n",
+         eval_cache_hits, eval_cache_probes, eval_cache_hits * 100 / (eval_cache_probes + 1));
+  printf("info string lazy eval exits %lld above beta %lld below alpha of %lld evals\n",
+         lazy_exits_high, lazy_exits_low, lazy_evals);
+
+  printf("bestmove ");
+  print_move(expand_move(pv_table[0][0]));
+  printf("\n");
+}
+
+// Mate search
+
+#define pn_infinity  100000000                                                                                         /* proof/disproof number of a solved node */
+#define pn_max_nodes (1 << 22)                                                                                         /* proof tree size limit */
+
+typedef struct                                                                                                         // proof tree node
+{
+  int move;                                                                                                            // move leading to the node
+  int proof;                                                                                                           // proof number (leaves still to prove for a mate)
+  int disproof;                                                                                                        // disproof number (leaves still to prove for no mate)
+  int first_child;                                                                                                     // index of the first child (-1 until expanded)
+  int children;                                                                                                        // number of children
+} pn_node;
+
+_Thread_local pn_node* pn_tree;                                                                                        // proof tree (children of a node are stored next to each other)
+_Thread_local int      pn_size;                                                                                        // proof tree nodes in use
+_Thread_local int      pn_capacity;                                                                                    // proof tree nodes allocated
+_Thread_local int      pn_full;                                                                                        // proof tree ran out of nodes
+
+// add a node to the proof tree, returns its index or -1 if the tree is full
+int
+pn_new_node(int move)
+{
+  if (pn_size == pn_capacity) {                                                                                        // grow the tree on demand
+    int      capacity = pn_capacity ? 2 * pn_capacity : 1 << 16;
+    pn_node* tree     = (capacity <= pn_max_nodes) ? realloc(pn_tree, capacity * sizeof(pn_node)) : NULL;
+    if (tree == NULL) {
+      pn_full = 1;
+      return -1;
+    }
+    pn_tree     = tree;
+    pn_capacity = capacity;
+  }
+  pn_tree[pn_size].move        = move;
+  pn_tree[pn_size].first_child = -1;
+  pn_tree[pn_size].children    = 0;
+  return pn_size++;
+}
+
+// generate the legal moves of a mate search node: checks for the attacker, evasions for the defender
+void
+generate_mate_moves(moves* move_list, int attacker)
+{
+  check_info checks;
+  moves      pseudo_legal[1];
+  generate_moves(pseudo_legal);
+  init_check_info(&checks);
+  move_list->count = 0;
+
+  for (int count = 0; count < pseudo_legal->count; count++) {
+    int move = pseudo_legal->moves[count];
+    if (attacker && gives_check(move, &checks) == 0) continue;                                                         // attacker plays only checks
+    copy_board();
+    if (make_move(move, all_moves)) {                                                                                  // keep only legal moves
+      add_move(move_list, move);
+      take_back();
+    }
+    nodes++;
+  }
+}
+
+// expand a proof tree node whose position is on the board
+void
+pn_expand(int node, int attacker, int remaining)
+{
+  moves move_list[1];
+  generate_mate_moves(move_list, attacker);
+
+  pn_tree[node].first_child = pn_size;
+  for (int count = 0; count < move_list->count; count++) {
+    int child = pn_new_node(move_list->moves[count]);
+    if (child == -1) {                                                                                                 // out of memory: leave the node unexpanded
+      pn_size                   = pn_tree[node].first_child;
+      pn_tree[node].first_child = -1;
+      return;
+    }
+
+    copy_board();
+    make_move(move_list->moves[count], all_moves);
+    moves replies[1];
+    generate_mate_moves(replies, attacker ^ 1);                                                                        // initialize the child by its mobility
+    take_back();
+
+    if (attacker) {                                                                                                    // defender to move in the child (after a check)
+      if      (replies->count == 0) pn_tree[child].proof = 0,           pn_tree[child].disproof = pn_infinity;         // checkmate
+      else if (remaining == 1)      pn_tree[child].proof = pn_infinity, pn_tree[child].disproof = 0;                   // out of attacking moves
+      else                          pn_tree[child].proof = replies->count, pn_tree[child].disproof = 1;
+    }
+    else {                                                                                                             // attacker to move in the child
+      if (replies->count == 0)      pn_tree[child].proof = pn_infinity, pn_tree[child].disproof = 0;                   // no checks left
+      else                          pn_tree[child].proof = 1,           pn_tree[child].disproof = replies->count;
+    }
+  }
+  pn_tree[node].children = move_list->count;
+}
+
+// set proof & disproof numbers of an expanded node from its children
+void
+pn_update(int node, int attacker)
+{
+  int minimum = pn_infinity;                                                                                           // OR node: proof is the minimum, disproof the sum
+  int sum     = 0;                                                                                                     // AND node: proof is the sum, disproof the minimum
+
+  for (int child = pn_tree[node].first_child; child < pn_tree[node].first_child + pn_tree[node].children; child++) {
+    int low  = attacker ? pn_tree[child].proof    : pn_tree[child].disproof;
+    int high = attacker ? pn_tree[child].disproof : pn_tree[child].proof;
+    if (low < minimum) minimum = low;
+    sum = (sum + high < pn_infinity) ? sum + high : pn_infinity;
+  }
+
+  if (pn_tree[node].children == 0)                                                                                     // no moves: no checks left or checkmate
+    minimum = pn_infinity, sum = 0;
+
+  pn_tree[node].proof    = attacker ? minimum : sum;
+  pn_tree[node].disproof = attacker ? sum     : minimum;
+}
+
+// descend to the most proving node, expand it and update proof numbers on the way back
+void
+pn_search(int node, int attacker, int remaining)
+{
+  if (pn_tree[node].first_child == -1) {
+    pn_expand(node, attacker, remaining);
+    if (pn_tree[node].first_child != -1) pn_update(node, attacker);
+    return;
+  }
+
+  int best = pn_tree[node].first_child;                                                                                // attacker proves the easiest check, defender
+  for (int child = best; child < pn_tree[node].first_child + pn_tree[node].children; child++)                          // disproves with the easiest evasion
+    if (attacker ? pn_tree[child].proof    < pn_tree[best].proof
+                 : pn_tree[child].disproof < pn_tree[best].disproof)
+      best = child;
+
+  copy_board();
+  make_move(pn_tree[best].move, all_moves);
+  pn_search(best, attacker ^ 1, attacker ? remaining - 1 : remaining);
+  take_back();
+
+  pn_update(node, attacker);
+}
+
+// plies to mate in a proven subtree (attacker mates as fast as possible, defender resists as long as possible)
+int
+pn_mate_length(int node, int attacker, int* best_child)
+{
+  int length = 0;
+  *best_child = -1;
+
+  for (int child = pn_tree[node].first_child; child < pn_tree[node].first_child + pn_tree[node].children; child++) {
+    if (pn_tree[child].proof != 0) continue;                                                                           // only proven moves lead to mate
+    int next;
+    int child_length = 1 + pn_mate_length(child, attacker ^ 1, &next);
+    if (*best_child == -1 || (attacker ? child_length < length : child_length > length)) {
+      *best_child = child;
+      length      = child_length;
+    }
+  }
+  return length;                                                                                                       // 0 for checkmate (unexpanded proven node)
+}
+
+// search for a forced mate in at most "mate" moves using proof-number search (checks & evasions only)
+void
+search_mate(int mate)
+{
+  nodes        = 0;                                                                                                    // reset nodes counter
+  stopped      = 0;                                                                                                    // reset "time is up" flag
+  stop_request = __atomic_load_n(&stop_requests, __ATOMIC_RELAXED);
+  memset(pv_table,  0, sizeof(pv_table));
+  memset(pv_length, 0, sizeof(pv_length));
+  search_score = 0;
+  search_depth = 0;
+  search_move  = 0;
+
+  int best_move = 0;
+
+  for (int current_mate = 1; current_mate <= mate && stopped == 0; current_mate++) {                                   // find the shortest mate first
+    pn_size = 0;
+    pn_full = 0;
+    int root = pn_new_node(0);
+    if (root == -1) break;
+    pn_tree[root].proof = pn_tree[root].disproof = 1;
+
+    for (int iteration = 1; pn_tree[root].proof && pn_tree[root].disproof && stopped == 0 && pn_full == 0; iteration++) {
+      pn_search(root, 1, current_mate);
+      if ((iteration & 255) == 0) communicate();                                                                       // "listen" to the GUI/user input
+    }
+
+    if (pn_tree[root].proof == 0) {                                                                                    // mate proven
+      int child;
+      int length   = pn_mate_length(root, 1, &child);
+      int attacker = 1;
+      pv_length[0] = 0;
+      for (int node = root; node != -1; attacker ^= 1) {                                                               // follow the longest resistance against the fastest mate
+        pn_mate_length(node, attacker, &child);
+        if (child != -1) pv_table[0][pv_length[0]++] = compact_move(pn_tree[child].move);
+        node = child;
+      }
+      print_search_info(mate_value - length, length, 0, pv_table[0], pv_length[0]);
+      search_score = mate_value - length, search_depth = length, search_move = root_move(pv_table[0][0]);
+      if (verbose == 0) return;
+      printf("bestmove ");
+      print_move(search_move);
+      printf("\n");
+      return;
+    }
+
+    int best = pn_tree[root].children ? pn_tree[root].first_child : -1;                                                // remember the most promising check
+    for (int child = best; child != -1 && child < pn_tree[root].first_child + pn_tree[root].children; child++)
+      if (pn_tree[child].proof < pn_tree[best].proof) best = child;
+    if (best != -1) best_move = pn_tree[best].move;
+
+    search_depth = 2 * current_mate - 1;
+    if (verbose) printf("info depth %d nodes %lld time %d\n", search_depth, nodes, get_time_ms() - starttime);
+    if (verbose && pn_full) printf("info string mate search ran out of memory\n");
+  }
+
+  if (stopped == 0 && pn_full == 0) {                                                                                  // no mate within the given number of moves
+    if (verbose) printf("info string no mate in %d\n", mate);
+    search_position(2 * mate);                                                                                         // fall back to the regular search for a move
+    return;
+  }
+
+  if (best_move == 0) {                                                                                                // interrupted before a check was found: any legal move
+    moves move_list[1];
+    generate_mate_moves(move_list, 0);
+    if (move_list->count) best_move = move_list->moves[0];
+  }
+  search_move = best_move;
+  if (verbose == 0) return;
+  printf("bestmove ");
+  print_move(best_move);
+  printf("\n");
+}
+
+// Opening book
+
+// Polyglot opening book (UCI "OwnBook" & "BookFile"). The .bin file is an array of 16 byte big endian entries
+// { key, move, weight, learn } sorted by key. It is memory mapped read only & shared, so it is searched in place
+// without being parsed, and every engine using the same book shares one copy in the page cache.
+// Keys XOR book_keys[64 * kind + 8 * rank + file] of every piece (kind: black pawn 0, white pawn 1, black knight 2 ...
+// white king 11; rank 0 is the 1st rank), [768 .. 771] of the castling rights K, Q, k, q, [772 + file] of an enpassant
+// square the side to move can capture on & [780] if white is to move.
+
+#define book_entry_size        16                                                                                      /* bytes per book entry */
+#define book_start_key         0x463b96181691fc9cULL                                                                   /* Polyglot key of the start position */
+#define book_read16(p)         ((p)[0] << 8 | (p)[1])                                                                  /* big endian reads */
+#define book_read64(p)         ((U64)book_read16(p) << 48 | (U64)book_read16((p) + 2) << 32 |                          \
+                                (U64)book_read16((p) + 4) << 16 | book_read16((p) + 6))
+
+const U64 book_keys[781] = {                                                                                           // Polyglot's Random64 table
+  0x9d39247e33776d41ULL, 0x2af7398005aaa5c7ULL, 0x44db015024623547ULL, 0x9c15f73e62a76ae2ULL,
+  0x75834465489c0c89ULL, 0x3290ac3a203001bfULL, 0x0fbbad1f61042279ULL, 0xe83a908ff2fb60caULL,
+  0x0d7e765d58755c10ULL, 0x1a083822ceafe02dULL, 0x9605d5f0e25ec3b0ULL, 0xd021ff5cd13a2ed5ULL,
+  0x40bdf15d4a672e32ULL, 0x011355146fd56395ULL, 0x5db4832046f3d9e5ULL, 0x239f8b2d7ff719ccULL,
+  0x05d1a1ae85b49aa1ULL, 0x679f848f6e8fc971ULL, 0x7449bbff801fed0bULL, 0x7d11cdb1c3b7adf0ULL,
+  0x82c7709e781eb7ccULL, 0xf3218f1c9510786cULL, 0x331478f3af51bbe6ULL, 0x4bb38de5e7219443ULL,
+  0xaa649c6ebcfd50fcULL, 0x8dbd98a352afd40bULL, 0x87d2074b81d79217ULL, 0x19f3c751d3e92ae1ULL,
+  0xb4ab30f062b19abfULL, 0x7b0500ac42047ac4ULL, 0xc9452ca81a09d85dULL, 0x24aa6c514da27500ULL,
+  0x4c9f34427501b447ULL, 0x14a68fd73c910841ULL, 0xa71b9b83461cbd93ULL, 0x03488b95b0f1850fULL,
+  0x637b2b34ff93c040ULL, 0x09d1bc9a3dd90a94ULL, 0x3575668334a1dd3bULL, 0x735e2b97a4c45a23ULL,
+  0x18727070f1bd400bULL, 0x1fcbacd259bf02e7ULL, 0xd310a7c2ce9b6555ULL, 0xbf983fe0fe5d8244ULL,
+  0x9f74d14f7454a824ULL, 0x51ebdc4ab9ba3035ULL, 0x5c82c505db9ab0faULL, 0xfcf7fe8a3430b241ULL,
+  0x3253a729b9ba3ddeULL, 0x8c74c368081b3075ULL, 0xb9bc6c87167c33e7ULL, 0x7ef48f2b83024e20ULL,
+  0x11d505d4c351bd7fULL, 0x6568fca92c76a243ULL, 0x4de0b0f40f32a7b8ULL, 0x96d693460cc37e5dULL,
+  0x42e240cb63689f2fULL, 0x6d2bdcdae2919661ULL, 0x42880b0236e4d951ULL, 0x5f0f4a5898171bb6ULL,
+  0x39f890f579f92f88ULL, 0x93c5b5f47356388bULL, 0x63dc359d8d231b78ULL, 0xec16ca8aea98ad76ULL,
+  0x5355f900c2a82dc7ULL, 0x07fb9f855a997142ULL, 0x5093417aa8a7ed5eULL, 0x7bcbc38da25a7f3cULL,
+  0x19fc8a768cf4b6d4ULL, 0x637a7780decfc0d9ULL, 0x8249a47aee0e41f7ULL, 0x79ad695501e7d1e8ULL,
+  0x14acbaf4777d5776ULL, 0xf145b6beccdea195ULL, 0xdabf2ac8201752fcULL, 0x24c3c94df9c8d3f6ULL,
+  0xbb6e2924f03912eaULL, 0x0ce26c0b95c980d9ULL, 0xa49cd132bfbf7cc4ULL, 0xe99d662af4243939ULL,
+  0x27e6ad7891165c3fULL, 0x8535f040b9744ff1ULL, 0x54b3f4fa5f40d873ULL, 0x72b12c32127fed2bULL,
+  0xee954d3c7b411f47ULL, 0x9a85ac909a24eaa1ULL, 0x70ac4cd9f04f21f5ULL, 0xf9b89d3e99a075c2ULL,
+  0x87b3e2b2b5c907b1ULL, 0xa366e5b8c54f48b8ULL, 0xae4a9346cc3f7cf2ULL, 0x1920c04d47267bbdULL,
+  0x87bf02c6b49e2ae9ULL, 0x092237ac237f3859ULL, 0xff07f64ef8ed14d0ULL, 0x8de8dca9f03cc54eULL,
+  0x9c1633264db49c89ULL, 0xb3f22c3d0b0b38edULL, 0x390e5fb44d01144bULL, 0x5bfea5b4712768e9ULL,
+  0x1e1032911fa78984ULL, 0x9a74acb964e78cb3ULL, 0x4f80f7a035dafb04ULL, 0x6304d09a0b3738c4ULL,
+  0x2171e64683023a08ULL, 0x5b9b63eb9ceff80cULL, 0x506aacf489889342ULL, 0x1881afc9a3a701d6ULL,
+  0x6503080440750644ULL, 0xdfd395339cdbf4a7ULL, 0xef927dbcf00c20f2ULL, 0x7b32f7d1e03680ecULL,
+  0xb9fd7620e7316243ULL, 0x05a7e8a57db91b77ULL, 0xb5889c6e15630a75ULL, 0x4a750a09ce9573f7ULL,
+  0xcf464cec899a2f8aULL, 0xf538639ce705b824ULL, 0x3c79a0ff5580ef7fULL, 0xede6c87f8477609dULL,
+  0x799e81f05bc93f31ULL, 0x86536b8cf3428a8cULL, 0x97d7374c60087b73ULL, 0xa246637cff328532ULL,
+  0x043fcae60cc0eba0ULL, 0x920e449535dd359eULL, 0x70eb093b15b290ccULL, 0x73a1921916591cbdULL,
+  0x56436c9fe1a1aa8dULL, 0xefac4b70633b8f81ULL, 0xbb215798d45df7afULL, 0x45f20042f24f1768ULL,
+  0x930f80f4e8eb7462ULL, 0xff6712ffcfd75ea1ULL, 0xae623fd67468aa70ULL, 0xdd2c5bc84bc8d8fcULL,
+  0x7eed120d54cf2dd9ULL, 0x22fe545401165f1cULL, 0xc91800e98fb99929ULL, 0x808bd68e6ac10365ULL,
+  0xdec468145b7605f6ULL, 0x1bede3a3aef53302ULL, 0x43539603d6c55602ULL, 0xaa969b5c691ccb7aULL,
+  0xa87832d392efee56ULL, 0x65942c7b3c7e11aeULL, 0xded2d633cad004f6ULL, 0x21f08570f420e565ULL,
+  0xb415938d7da94e3cULL, 0x91b859e59ecb6350ULL, 0x10cff333e0ed804aULL, 0x28aed140be0bb7ddULL,
+  0xc5cc1d89724fa456ULL, 0x5648f680f11a2741ULL, 0x2d255069f0b7dab3ULL, 0x9bc5a38ef729abd4ULL,
+  0xef2f054308f6a2bcULL, 0xaf2042f5cc5c2858ULL, 0x480412bab7f5be2aULL, 0xaef3af4a563dfe43ULL,
+  0x19afe59ae451497fULL, 0x52593803dff1e840ULL, 0xf4f076e65f2ce6f0ULL, 0x11379625747d5af3ULL,
+  0xbce5d2248682c115ULL, 0x9da4243de836994fULL, 0x066f70b33fe09017ULL, 0x4dc4de189b671a1cULL,
+  0x51039ab7712457c3ULL, 0xc07a3f80c31fb4b4ULL, 0xb46ee9c5e64a6e7cULL, 0xb3819a42abe61c87ULL,
+  0x21a007933a522a20ULL, 0x2df16f761598aa4fULL, 0x763c4a1371b368fdULL, 0xf793c46702e086a0ULL,
+  0xd7288e012aeb8d31ULL, 0xde336a2a4bc1c44bULL, 0x0bf692b38d079f23ULL, 0x2c604a7a177326b3ULL,
+  0x4850e73e03eb6064ULL, 0xcfc447f1e53c8e1bULL, 0xb05ca3f564268d99ULL, 0x9ae182c8bc9474e8ULL,
+  0xa4fc4bd4fc5558caULL, 0xe755178d58fc4e76ULL, 0x69b97db1a4c03dfeULL, 0xf9b5b7c4acc67c96ULL,
+  0xfc6a82d64b8655fbULL, 0x9c684cb6c4d24417ULL, 0x8ec97d2917456ed0ULL, 0x6703df9d2924e97eULL,
+  0xc547f57e42a7444eULL, 0x78e37644e7cad29eULL, 0xfe9a44e9362f05faULL, 0x08bd35cc38336615ULL,
+  0x9315e5eb3a129aceULL, 0x94061b871e04df75ULL, 0xdf1d9f9d784ba010ULL, 0x3bba57b68871b59dULL,
+  0xd2b7adeeded1f73fULL, 0xf7a255d83bc373f8ULL, 0xd7f4f2448c0ceb81ULL, 0xd95be88cd210ffa7ULL,
+  0x336f52f8ff4728e7ULL, 0xa74049dac312ac71ULL, 0xa2f61bb6e437fdb5ULL, 0x4f2a5cb07f6a35b3ULL,
+  0x87d380bda5bf7859ULL, 0x16b9f7e06c453a21ULL, 0x7ba2484c8a0fd54eULL, 0xf3a678cad9a2e38cULL,
+  0x39b0bf7dde437ba2ULL, 0xfcaf55c1bf8a4424ULL, 0x18fcf680573fa594ULL, 0x4c0563b89f495ac3ULL,
+  0x40e087931a00930dULL, 0x8cffa9412eb642c1ULL, 0x68ca39053261169fULL, 0x7a1ee967d27579e2ULL,
+  0x9d1d60e5076f5b6fULL, 0x3810e399b6f65ba2ULL, 0x32095b6d4ab5f9b1ULL, 0x35cab62109dd038aULL,
+  0xa90b24499fcfafb1ULL, 0x77a225a07cc2c6bdULL, 0x513e5e634c70e331ULL, 0x4361c0ca3f692f12ULL,
+  0xd941aca44b20a45bULL, 0x528f7c8602c5807bULL, 0x52ab92beb9613989ULL, 0x9d1dfa2efc557f73ULL,
+  0x722ff175f572c348ULL, 0x1d1260a51107fe97ULL, 0x7a249a57ec0c9ba2ULL, 0x04208fe9e8f7f2d6ULL,
+  0x5a110c6058b920a0ULL, 0x0cd9a497658a5698ULL, 0x56fd23c8f9715a4cULL, 0x284c847b9d887aaeULL,
+  0x04feabfbbdb619cbULL, 0x742e1e651c60ba83ULL, 0x9a9632e65904ad3cULL, 0x881b82a13b51b9e2ULL,
+  0x506e6744cd974924ULL, 0xb0183db56ffc6a79ULL, 0x0ed9b915c66ed37eULL, 0x5e11e86d5873d484ULL,
+  0xf678647e3519ac6eULL, 0x1b85d488d0f20cc5ULL, 0xdab9fe6525d89021ULL, 0x0d151d86adb73615ULL,
+  0xa865a54edcc0f019ULL, 0x93c42566aef98ffbULL, 0x99e7afeabe000731ULL, 0x48cbff086ddf285aULL,
+  0x7f9b6af1ebf78bafULL, 0x58627e1a149bba21ULL, 0x2cd16e2abd791e33ULL, 0xd363eff5f0977996ULL,
+  0x0ce2a38c344a6eedULL, 0x1a804aadb9cfa741ULL, 0x907f30421d78c5deULL, 0x501f65edb3034d07ULL,
+  0x37624ae5a48fa6e9ULL, 0x957baf61700cff4eULL, 0x3a6c27934e31188aULL, 0xd49503536abca345ULL,
+  0x088e049589c432e0ULL, 0xf943aee7febf21b8ULL, 0x6c3b8e3e336139d3ULL, 0x364f6ffa464ee52eULL,
+  0xd60f6dcedc314222ULL, 0x56963b0dca418fc0ULL, 0x16f50edf91e513afULL, 0xef1955914b609f93ULL,
+  0x565601c0364e3228ULL, 0xecb53939887e8175ULL, 0xbac7a9a18531294bULL, 0xb344c470397bba52ULL,
+  0x65d34954daf3cebdULL, 0xb4b81b3fa97511e2ULL, 0xb422061193d6f6a7ULL, 0x071582401c38434dULL,
+  0x7a13f18bbedc4ff5ULL, 0xbc4097b116c524d2ULL, 0x59b97885e2f2ea28ULL, 0x99170a5dc3115544ULL,
+  0x6f423357e7c6a9f9ULL, 0x325928ee6e6f8794ULL, 0xd0e4366228b03343ULL, 0x565c31f7de89ea27ULL,
+  0x30f5611484119414ULL, 0xd873db391292ed4fULL, 0x7bd94e1d8e17debcULL, 0xc7d9f16864a76e94ULL,
+  0x947ae053ee56e63cULL, 0xc8c93882f9475f5fULL, 0x3a9bf55ba91f81caULL, 0xd9a11fbb3d9808e4ULL,
+  0x0fd22063edc29fcaULL, 0xb3f256d8aca0b0b9ULL, 0xb03031a8b4516e84ULL, 0x35dd37d5871448afULL,
+  0xe9f6082b05542e4eULL, 0xebfafa33d7254b59ULL, 0x9255abb50d532280ULL, 0xb9ab4ce57f2d34f3ULL,
+  0x693501d628297551ULL, 0xc62c58f97dd949bfULL, 0xcd454f8f19c5126aULL, 0xbbe83f4ecc2bdecbULL,
+  0xdc842b7e2819e230ULL, 0xba89142e007503b8ULL, 0xa3bc941d0a5061cbULL, 0xe9f6760e32cd8021ULL,
+  0x09c7e552bc76492fULL, 0x852f54934da55cc9ULL, 0x8107fccf064fcf56ULL, 0x098954d51fff6580ULL,
+  0x23b70edb1955c4bfULL, 0xc330de426430f69dULL, 0x4715ed43e8a45c0aULL, 0xa8d7e4dab780a08dULL,
+  0x0572b974f03ce0bbULL, 0xb57d2e985e1419c7ULL, 0xe8d9ecbe2cf3d73fULL, 0x2fe4b17170e59750ULL,
+  0x11317ba87905e790ULL, 0x7fbf21ec8a1f45ecULL, 0x1725cabfcb045b00ULL, 0x964e915cd5e2b207ULL,
+  0x3e2b8bcbf016d66dULL, 0xbe7444e39328a0acULL, 0xf85b2b4fbcde44b7ULL, 0x49353fea39ba63b1ULL,
+  0x1dd01aafcd53486aULL, 0x1fca8a92fd719f85ULL, 0xfc7c95d827357afaULL, 0x18a6a990c8b35ebdULL,
+  0xcccb7005c6b9c28dULL, 0x3bdbb92c43b17f26ULL, 0xaa70b5b4f89695a2ULL, 0xe94c39a54a98307fULL,
+  0xb7a0b174cff6f36eULL, 0xd4dba84729af48adULL, 0x2e18bc1ad9704a68ULL, 0x2de0966daf2f8b1cULL,
+  0xb9c11d5b1e43a07eULL, 0x64972d68dee33360ULL, 0x94628d38d0c20584ULL, 0xdbc0d2b6ab90a559ULL,
+  0xd2733c4335c6a72fULL, 0x7e75d99d94a70f4dULL, 0x6ced1983376fa72bULL, 0x97fcaacbf030bc24ULL,
+  0x7b77497b32503b12ULL, 0x8547eddfb81ccb94ULL, 0x79999cdff70902cbULL, 0xcffe1939438e9b24ULL,
+  0x829626e3892d95d7ULL, 0x92fae24291f2b3f1ULL, 0x63e22c147b9c3403ULL, 0xc678b6d860284a1cULL,
+  0x5873888850659ae7ULL, 0x0981dcd296a8736dULL, 0x9f65789a6509a440ULL, 0x9ff38fed72e9052fULL,
+  0xe479ee5b9930578cULL, 0xe7f28ecd2d49eecdULL, 0x56c074a581ea17feULL, 0x5544f7d774b14aefULL,
+  0x7b3f0195fc6f290fULL, 0x12153635b2c0cf57ULL, 0x7f5126dbba5e0ca7ULL, 0x7a76956c3eafb413ULL,
+  0x3d5774a11d31ab39ULL, 0x8a1b083821f40cb4ULL, 0x7b4a38e32537df62ULL, 0x950113646d1d6e03ULL,
+  0x4da8979a0041e8a9ULL, 0x3bc36e078f7515d7ULL, 0x5d0a12f27ad310d1ULL, 0x7f9d1a2e1ebe1327ULL,
+  0xda3a361b1c5157b1ULL, 0xdcdd7d20903d0c25ULL, 0x36833336d068f707ULL, 0xce68341f79893389ULL,
+  0xab9090168dd05f34ULL, 0x43954b3252dc25e5ULL, 0xb438c2b67f98e5e9ULL, 0x10dcd78e3851a492ULL,
+  0xdbc27ab5447822bfULL, 0x9b3cdb65f82ca382ULL, 0xb67b7896167b4c84ULL, 0xbfced1b0048eac50ULL,
+  0xa9119b60369ffebdULL, 0x1fff7ac80904bf45ULL, 0xac12fb171817eee7ULL, 0xaf08da9177dda93dULL,
+  0x1b0cab936e65c744ULL, 0xb559eb1d04e5e932ULL, 0xc37b45b3f8d6f2baULL, 0xc3a9dc228caac9e9ULL,
+  0xf3b8b6675a6507ffULL, 0x9fc477de4ed681daULL, 0x67378d8eccef96cbULL, 0x6dd856d94d259236ULL,
+  0xa319ce15b0b4db31ULL, 0x073973751f12dd5eULL, 0x8a8e849eb32781a5ULL, 0xe1925c71285279f5ULL,
+  0x74c04bf1790c0efeULL, 0x4dda48153c94938aULL, 0x9d266d6a1cc0542cULL, 0x7440fb816508c4feULL,
+  0x13328503df48229fULL, 0xd6bf7baee43cac40ULL, 0x4838d65f6ef6748fULL, 0x1e152328f3318deaULL,
+  0x8f8419a348f296bfULL, 0x72c8834a5957b511ULL, 0xd7a023a73260b45cULL, 0x94ebc8abcfb56daeULL,
+  0x9fc10d0f989993e0ULL, 0xde68a2355b93cae6ULL, 0xa44cfe79ae538bbeULL, 0x9d1d84fcce371425ULL,
+  0x51d2b1ab2ddfb636ULL, 0x2fd7e4b9e72cd38cULL, 0x65ca5b96b7552210ULL, 0xdd69a0d8ab3b546dULL,
+  0x604d51b25fbf70e2ULL, 0x73aa8a564fb7ac9eULL, 0x1a8c1e992b941148ULL, 0xaac40a2703d9bea0ULL,
+  0x764dbeae7fa4f3a6ULL, 0x1e99b96e70a9be8bULL, 0x2c5e9deb57ef4743ULL, 0x3a938fee32d29981ULL,
+  0x26e6db8ffdf5adfeULL, 0x469356c504ec9f9dULL, 0xc8763c5b08d1908cULL, 0x3f6c6af859d80055ULL,
+  0x7f7cc39420a3a545ULL, 0x9bfb227ebdf4c5ceULL, 0x89039d79d6fc5c5cULL, 0x8fe88b57305e2ab6ULL,
+  0xa09e8c8c35ab96deULL, 0xfa7e393983325753ULL, 0xd6b6d0ecc617c699ULL, 0xdfea21ea9e7557e3ULL,
+  0xb67c1fa481680af8ULL, 0xca1e3785a9e724e5ULL, 0x1cfc8bed0d681639ULL, 0xd18d8549d140caeaULL,
+  0x4ed0fe7e9dc91335ULL, 0xe4dbf0634473f5d2ULL, 0x1761f93a44d5aefeULL, 0x53898e4c3910da55ULL,
+  0x734de8181f6ec39aULL, 0x2680b122baa28d97ULL, 0x298af231c85bafabULL, 0x7983eed3740847d5ULL,
+  0x66c1a2a1a60cd889ULL, 0x9e17e49642a3e4c1ULL, 0xedb454e7badc0805ULL, 0x50b704cab602c329ULL,
+  0x4cc317fb9cddd023ULL, 0x66b4835d9eafea22ULL, 0x219b97e26ffc81bdULL, 0x261e4e4c0a333a9dULL,
+  0x1fe2cca76517db90ULL, 0xd7504dfa8816edbbULL, 0xb9571fa04dc089c8ULL, 0x1ddc0325259b27deULL,
+  0xcf3f4688801eb9aaULL, 0xf4f5d05c10cab243ULL, 0x38b6525c21a42b0eULL, 0x36f60e2ba4fa6800ULL,
+  0xeb3593803173e0ceULL, 0x9c4cd6257c5a3603ULL, 0xaf0c317d32adaa8aULL, 0x258e5a80c7204c4bULL,
+  0x8b889d624d44885dULL, 0xf4d14597e660f855ULL, 0xd4347f66ec8941c3ULL, 0xe699ed85b0dfb40dULL,
+  0x2472f6207c2d0484ULL, 0xc2a1e7b5b459aeb5ULL, 0xab4f6451cc1d45ecULL, 0x63767572ae3d6174ULL,
+  0xa59e0bd101731a28ULL, 0x116d0016cb948f09ULL, 0x2cf9c8ca052f6e9fULL, 0x0b090a7560a968e3ULL,
+  0xabeeddb2dde06ff1ULL, 0x58efc10b06a2068dULL, 0xc6e57a78fbd986e0ULL, 0x2eab8ca63ce802d7ULL,
+  0x14a195640116f336ULL, 0x7c0828dd624ec390ULL, 0xd74bbe77e6116ac7ULL, 0x804456af10f5fb53ULL,
+  0xebe9ea2adf4321c7ULL, 0x03219a39ee587a30ULL, 0x49787fef17af9924ULL, 0xa1e9300cd8520548ULL,
+  0x5b45e522e4b1b4efULL, 0xb49c3b3995091a36ULL, 0xd4490ad526f14431ULL, 0x12a8f216af9418c2ULL,
+  0x001f837cc7350524ULL, 0x1877b51e57a764d5ULL, 0xa2853b80f17f58eeULL, 0x993e1de72d36d310ULL,
+  0xb3598080ce64a656ULL, 0x252f59cf0d9f04bbULL, 0xd23c8e176d113600ULL, 0x1bda0492e7e4586eULL,
+  0x21e0bd5026c619bfULL, 0x3b097adaf088f94eULL, 0x8d14dedb30be846eULL, 0xf95cffa23af5f6f4ULL,
+  0x3871700761b3f743ULL, 0xca672b91e9e4fa16ULL, 0x64c8e531bff53b55ULL, 0x241260ed4ad1e87dULL,
+  0x106c09b972d2e822ULL, 0x7fba195410e5ca30ULL, 0x7884d9bc6cb569d8ULL, 0x0647dfedcd894a29ULL,
+  0x63573ff03e224774ULL, 0x4fc8e9560f91b123ULL, 0x1db956e450275779ULL, 0xb8d91274b9e9d4fbULL,
+  0xa2ebee47e2fbfce1ULL, 0xd9f1f30ccd97fb09ULL, 0xefed53d75fd64e6bULL, 0x2e6d02c36017f67fULL,
+  0xa9aa4d20db084e9bULL, 0xb64be8d8b25396c1ULL, 0x70cb6af7c2d5bcf0ULL, 0x98f076a4f7a2322eULL,
+  0xbf84470805e69b5fULL, 0x94c3251f06f90cf3ULL, 0x3e003e616a6591e9ULL, 0xb925a6cd0421aff3ULL,
+  0x61bdd1307c66e300ULL, 0xbf8d5108e27e0d48ULL, 0x240ab57a8b888b20ULL, 0xfc87614baf287e07ULL,
+  0xef02cdd06ffdb432ULL, 0xa1082c0466df6c0aULL, 0x8215e577001332c8ULL, 0xd39bb9c3a48db6cfULL,
+  0x2738259634305c14ULL, 0x61cf4f94c97df93dULL, 0x1b6baca2ae4e125bULL, 0x758f450c88572e0bULL,
+  0x959f587d507a8359ULL, 0xb063e962e045f54dULL, 0x60e8ed72c0dff5d1ULL, 0x7b64978555326f9fULL,
+  0xfd080d236da814baULL, 0x8c90fd9b083f4558ULL, 0x106f72fe81e2c590ULL, 0x7976033a39f7d952ULL,
+  0xa4ec0132764ca04bULL, 0x733ea705fae4fa77ULL, 0xb4d8f77bc3e56167ULL, 0x9e21f4f903b33fd9ULL,
+  0x9d765e419fb69f6dULL, 0xd30c088ba61ea5efULL, 0x5d94337fbfaf7f5bULL, 0x1a4e4822eb4d7a59ULL,
+  0x6ffe73e81b637fb3ULL, 0xddf957bc36d8b9caULL, 0x64d0e29eea8838b3ULL, 0x08dd9bdfd96b9f63ULL,
+  0x087e79e5a57d1d13ULL, 0xe328e230e3e2b3fbULL, 0x1c2559e30f0946beULL, 0x720bf5f26f4d2eaaULL,
+  0xb0774d261cc609dbULL, 0x443f64ec5a371195ULL, 0x4112cf68649a260eULL, 0xd813f2fab7f5c5caULL,
+  0x660d3257380841eeULL, 0x59ac2c7873f910a3ULL, 0xe846963877671a17ULL, 0x93b633abfa3469f8ULL,
+  0xc0c0f5a60ef4cdcfULL, 0xcaf21ecd4377b28cULL, 0x57277707199b8175ULL, 0x506c11b9d90e8b1dULL,
+  0xd83cc2687a19255fULL, 0x4a29c6465a314cd1ULL, 0xed2df21216235097ULL, 0xb5635c95ff7296e2ULL,
+  0x22af003ab672e811ULL, 0x52e762596bf68235ULL, 0x9aeba33ac6ecc6b0ULL, 0x944f6de09134dfb6ULL,
+  0x6c47bec883a7de39ULL, 0x6ad047c430a12104ULL, 0xa5b1cfdba0ab4067ULL, 0x7c45d833aff07862ULL,
+  0x5092ef950a16da0bULL, 0x9338e69c052b8e7bULL, 0x455a4b4cfe30e3f5ULL, 0x6b02e63195ad0cf8ULL,
+  0x6b17b224bad6bf27ULL, 0xd1e0ccd25bb9c169ULL, 0xde0c89a556b9ae70ULL, 0x50065e535a213cf6ULL,
+  0x9c1169fa2777b874ULL, 0x78edefd694af1eedULL, 0x6dc93d9526a50e68ULL, 0xee97f453f06791edULL,
+  0x32ab0edb696703d3ULL, 0x3a6853c7e70757a7ULL, 0x31865ced6120f37dULL, 0x67fef95d92607890ULL,
+  0x1f2b1d1f15f6dc9cULL, 0xb69e38a8965c6b65ULL, 0xaa9119ff184cccf4ULL, 0xf43c732873f24c13ULL,
+  0xfb4a3d794a9a80d2ULL, 0x3550c2321fd6109cULL, 0x371f77e76bb8417eULL, 0x6bfa9aae5ec05779ULL,
+  0xcd04f3ff001a4778ULL, 0xe3273522064480caULL, 0x9f91508bffcfc14aULL, 0x049a7f41061a9e60ULL,
+  0xfcb6be43a9f2fe9bULL, 0x08de8a1c7797da9bULL, 0x8f9887e6078735a1ULL, 0xb5b4071dbfc73a66ULL,
+  0x230e343dfba08d33ULL, 0x43ed7f5a0fae657dULL, 0x3a88a0fbbcb05c63ULL, 0x21874b8b4d2dbc4fULL,
+  0x1bdea12e35f6a8c9ULL, 0x53c065c6c8e63528ULL, 0xe34a1d250e7a8d6bULL, 0xd6b04d3b7651dd7eULL,
+  0x5e90277e7cb39e2dULL, 0x2c046f22062dc67dULL, 0xb10bb459132d0a26ULL, 0x3fa9ddfb67e2f199ULL,
+  0x0e09b88e1914f7afULL, 0x10e8b35af3eeab37ULL, 0x9eedeca8e272b933ULL, 0xd4c718bc4ae8ae5fULL,
+  0x81536d601170fc20ULL, 0x91b534f885818a06ULL, 0xec8177f83f900978ULL, 0x190e714fada5156eULL,
+  0xb592bf39b0364963ULL, 0x89c350c893ae7dc1ULL, 0xac042e70f8b383f2ULL, 0xb49b52e587a1ee60ULL,
+  0xfb152fe3ff26da89ULL, 0x3e666e6f69ae2c15ULL, 0x3b544ebe544c19f9ULL, 0xe805a1e290cf2456ULL,
+  0x24b33c9d7ed25117ULL, 0xe74733427b72f0c1ULL, 0x0a804d18b7097475ULL, 0x57e3306d881edb4fULL,
+  0x4ae7d6a36eb5dbcbULL, 0x2d8d5432157064c8ULL, 0xd1e649de1e7f268bULL, 0x8a328a1cedfe552cULL,
+  0x07a3aec79624c7daULL, 0x84547ddc3e203c94ULL, 0x990a98fd5071d263ULL, 0x1a4ff12616eefc89ULL,
+  0xf6f7fd1431714200ULL, 0x30c05b1ba332f41cULL, 0x8d2636b81555a786ULL, 0x46c9feb55d120902ULL,
+  0xccec0a73b49c9921ULL, 0x4e9d2827355fc492ULL, 0x19ebb029435dcb0fULL, 0x4659d2b743848a2cULL,
+  0x963ef2c96b33be31ULL, 0x74f85198b05a2e7dULL, 0x5a0f544dd2b1fb18ULL, 0x03727073c2e134b1ULL,
+  0xc7f6aa2de59aea61ULL, 0x352787baa0d7c22fULL, 0x9853eab63b5e0b35ULL, 0xabbdcdd7ed5c0860ULL,
+  0xcf05daf5ac8d77b0ULL, 0x49cad48cebf4a71eULL, 0x7a4c10ec2158c4a6ULL, 0xd9e92aa246bf719eULL,
+  0x13ae978d09fe5557ULL, 0x730499af921549ffULL, 0x4e4b705b92903ba4ULL, 0xff577222c14f0a3aULL,
+  0x55b6344cf97aafaeULL, 0xb862225b055b6960ULL, 0xcac09afbddd2cdb4ULL, 0xdaf8e9829fe96b5fULL,
+  0xb5fdfc5d3132c498ULL, 0x310cb380db6f7503ULL, 0xe87fbb46217a360eULL, 0x2102ae466ebb1148ULL,
+  0xf8549e1a3aa5e00dULL, 0x07a69afdcc42261aULL, 0xc4c118bfe78feaaeULL, 0xf9f4892ed96bd438ULL,
+  0x1af3dbe25d8f45daULL, 0xf5b4b0b0d2deeeb4ULL, 0x962aceefa82e1c84ULL, 0x046e3ecaaf453ce9ULL,
+  0xf05d129681949a4cULL, 0x964781ce734b3c84ULL, 0x9c2ed44081ce5fbdULL, 0x522e23f3925e319eULL,
+  0x177e00f9fc32f791ULL, 0x2bc60a63a6f3b3f2ULL, 0x222bbfae61725606ULL, 0x486289ddcc3d6780ULL,
+  0x7dc7785b8efdfc80ULL, 0x8af38731c02ba980ULL, 0x1fab64ea29a2ddf7ULL, 0xe4d9429322cd065aULL,
+  0x9da058c67844f20cULL, 0x24c0e332b70019b0ULL, 0x233003b5a6cfe6adULL, 0xd586bd01c5c217f6ULL,
+  0x5e5637885f29bc2bULL, 0x7eba726d8c94094bULL, 0x0a56a5f0bfe39272ULL, 0xd79476a84ee20d06ULL,
+  0x9e4c1269baa4bf37ULL, 0x17efee45b0dee640ULL, 0x1d95b0a5fcf90bc6ULL, 0x93cbe0b699c2585dULL,
+  0x65fa4f227a2b6d79ULL, 0xd5f9e858292504d5ULL, 0xc2b5a03f71471a6fULL, 0x59300222b4561e00ULL,
+  0xce2f8642ca0712dcULL, 0x7ca9723fbb2e8988ULL, 0x2785338347f2ba08ULL, 0xc61bb3a141e50e8cULL,
+  0x150f361dab9dec26ULL, 0x9f6a419d382595f4ULL, 0x64a53dc924fe7ac9ULL, 0x142de49fff7a7c3dULL,
+  0x0c335248857fa9e7ULL, 0x0a9c32d5eae45305ULL, 0xe6c42178c4bbb92eULL, 0x71f1ce2490d20b07ULL,
+  0xf1bcc3d275afe51aULL, 0xe728e8c83c334074ULL, 0x96fbf83a12884624ULL, 0x81a1549fd6573da5ULL,
+  0x5fa7867caf35e149ULL, 0x56986e2ef3ed091bULL, 0x917f1dd5f8886c61ULL, 0xd20d8c88c8ffe65fULL,
+  0x31d71dce64b2c310ULL, 0xf165b587df898190ULL, 0xa57e6339dd2cf3a0ULL, 0x1ef6e6dbb1961ec9ULL,
+  0x70cc73d90bc26e24ULL, 0xe21a6b35df0c3ad7ULL, 0x003a93d8b2806962ULL, 0x1c99ded33cb890a1ULL,
+  0xcf3145de0add4289ULL, 0xd0e4427a5514fb72ULL, 0x77c621cc9fb3a483ULL, 0x67a34dac4356550bULL,
+  0xf8d626aaaf278509ULL
+};
+
+unsigned char* book_data;                                                                                              // mapped book file
+U64            book_size;                                                                                              // its size in bytes
+U64            book_entries;                                                                                           // & in entries
+int            own_book;                                                                                               // play book moves (UCI "OwnBook")
+char           book_file[1024];                                                                                        // book path (UCI "BookFile")
+
+// book key of the current position
+U64
+book_key()
+{
+  U64 key = 0ULL;
+
+  for (int piece = P; piece <= k; piece++) {                                                                           // loop over piece bitboards
+    U64 bitboard = bitboards[piece];
+    int kind     = 2 * (piece % 6) + (piece < p);                                                                      // black piece before white one of a type
+    while (bitboard) {
+      Square square = get_ls1b_index(bitboard);
+      key ^= book_keys[64 * kind + 8 * (7 - square / 8) + square % 8];                                                 // our square 0 is a8
+      pop_bit(bitboard, square);
+    }
+  }
+  for (int right = 0; right < 4; right++)                                                                              // castling rights in WK, WQ, BK, BQ order
+    if (castle & (1 << right)) key ^= book_keys[768 + right];
+  if (enpassant != no_sq && (pawn_attacks[side ^ 1][enpassant] & bitboards[side == WHITE ? P : p]))                    // only hash capturable enpassant
+    key ^= book_keys[772 + enpassant % 8];
+  if (side == WHITE) key ^= book_keys[780];
+
+  return key;
+}
+
+// legal move of a book move code (0 if none)
+int
+book_decode_move(int code)
+{
+  int target   = (7 - (code >> 3 & 7)) * 8 + (code & 7);                                                               // to file & rank in bits 0-5
+  int source   = (7 - (code >> 9 & 7)) * 8 + (code >> 6 & 7);                                                          // from file & rank in bits 6-11
+  int promoted = code >> 12 & 7;                                                                                       // 1 knight, 2 bishop, 3 rook, 4 queen
+
+  if (source == e1 && get_bit(bitboards[K], e1) && (target == h1 || target == a1)) target = (target == h1) ? g1 : c1;  // castling is coded as king takes rook
+  if (source == e8 && get_bit(bitboards[k], e8) && (target == h8 || target == a8)) target = (target == h8) ? g8 : c8;
+
+  moves move_list[1];
+  generate_moves(move_list);
+
+  for (int count = 0; count < move_list->count; count++) {
+    int move = move_list->moves[count];
+    if (get_move_source(move) != source || get_move_target(move) != target) continue;
+    if (get_move_promoted(move) % 6 != promoted) continue;                                                             // N, B, R, Q happen to be 1 .. 4 as well
+    copy_board();
+    if (make_move(move, all_moves)) {                                                                                  // book might be corrupt or keys might collide
+      take_back();
+      return move;
+    }
+  }
+  return 0;
+}
+
+// pick a book move for the current position at random, weighted by the entry weights (0 if out of book)
+int
+book_move()
+{
+  if (book_data == NULL) return 0;
+
+  U64 key = book_key(), low = 0, high = book_entries;
+  while (low < high) {                                                                                                 // binary search for the first entry of the key
+    U64 middle = (low + high) / 2;
+    if (book_read64(book_data + middle * book_entry_size) < key) low  = middle + 1;
+    else                                                         high = middle;
+  }
+
+  unsigned int total = 0;
+  for (U64 index = low; index < book_entries && book_read64(book_data + index * book_entry_size) == key; index++)
+    total += book_read16(book_data + index * book_entry_size + 10);
+  if (total == 0) return 0;
+
+  unsigned int pick = (get_random_U32_number() ^ get_time_ms()) % total;
+  for (U64 index = low; ; index++) {
+    unsigned char* entry  = book_data + index * book_entry_size;
+    unsigned int   weight = book_read16(entry + 10);
+    if (pick < weight) return book_decode_move(book_read16(entry + 8));
+    pick -= weight;
+  }
+}
+
+// (re)map the book file
+void
+book_init(char* path)
+{
+  if (book_data) munmap(book_data, book_size);                                                                         // forget the old book
+  book_data = NULL, book_size = book_entries = 0;
+
+  strncpy(book_file, path, sizeof(book_file) - 1);
+  if (*book_file == 0 || strcmp(book_file, "<empty>") == 0) return;
+
+  board_state current;                                                                                                 // check the keys on the start position
+  int         index = repetition_index;
+  save_board(&current);
+  parse_fen(start_position);
+  U64 start_key = book_key();
+  restore_board(&current);
+  repetition_index = index;
+  if (start_key != book_start_key) {
+    printf("info string book keys don't match Polyglot's (start position %llx)\n", start_key);
+    return;
+  }
+
+  int descriptor = open(book_file, O_RDONLY);
+  void* data     = MAP_FAILED;
+  struct stat status;
+  if (descriptor >= 0) {
+    fstat(descriptor, &status);
+    if (status.st_size >= book_entry_size) data = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+    close(descriptor);
+  }
+  if (data == MAP_FAILED) {
+    printf("info string failed to load book from %s\n", book_file);
+    return;
+  }
+  madvise(data, status.st_size, MADV_RANDOM);                                                                          // lookups touch a few pages only
+
+  book_data    = data;
+  book_size    = status.st_size;
+  book_entries = book_size / book_entry_size;
+  printf("info string book loaded from %s (%lld entries)\n", book_file, book_entries);
+}
+
+// Bench
+
+#define bench_depth 7                                                                                                  /* default bench search depth */
+
+char* bench_positions[] = {                                                                                            // bench positions (FEN)
+  start_position,
+  tricky_position,
+  killer_position,
+  cmk_position,
+  repetitions,
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1 ",
+  "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1 ",
+  "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8 ",
+  "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10 ",
+  "8/8/1p6/3k4/8/2K5/1P6/8 w - - 0 1 ",
+};
+
+// search every bench position to a fixed depth and report time to depth & node counts
+void
+bench(int depth)
+{
+  U64 total_nodes = 0;                                                                                                 // nodes searched over all positions
+  int start       = get_time_ms();                                                                                     // init start time
+  int positions   = sizeof(bench_positions) / sizeof(bench_positions[0]);
+
+  timeset = 0;                                                                                                         // fixed depth search, no time control
+
+  for (int index = 0; index < positions; index++) {                                                                    // loop over bench positions
+    printf("\n     Position %d/%d: %s\n\n", index + 1, positions, bench_positions[index]);
+    parse_fen(bench_positions[index]);                                                                                 // init chess board
+    clear_hash_table();                                                                                                // search every position from scratch
+    clear_eval_cache();
+    starttime = get_time_ms();
+    search_position(depth);                                                                                            // search position
+    total_nodes += nodes;
+  }
+
+  int time_ms = get_time_ms() - start;                                                                                 // total time to depth
+
+  printf("\n     Depth: %d\n",    depth);
+  printf("     Nodes: %lld\n",    total_nodes);
+  printf("      Time: %d\n",      time_ms);
+  printf("       NPS: %lld\n\n", total_nodes * 1000 / (time_ms + 1));
+}
+
+// Position files
+
+// Positions come as EPD/FEN lines or as packed records, 32 bytes each (little endian) so that a file of them can be
+// memory mapped & used in place:
+//
+//   bytes  0 .. 7    occupancy bitboard (engine square order, a8 = bit 0)
+//   bytes  8 .. 23   piece code (P .. k = 0 .. 11) of every occupied square in square order, a nibble each (low first)
+//   byte  24         side to move (bit 0) | castling rights << 1
+//   byte  25         enpassant square (no_sq if none)
+//   byte  26         fifty move counter
+//   byte  27         reserved (0)
+//   bytes 28 .. 29   full move number
+//   bytes 30 .. 31   reserved (0)
+//
+// "bbc pack <in or -> <out or ->" converts EPD/FEN lines to records, "bbc unpack <in or -> <out or ->" back to FENs.
+
+#define packed_size      32                                                                                            /* bytes per packed position */
+#define packed_extension ".packed"                                                                                     /* batch & perft map files named like this */
+
+// both kings are on the board, the side to move can't take one & the position fits a packed record
+int
+valid_position()
+{
+  return count_bits(bitboards[K]) == 1 && count_bits(bitboards[k]) == 1 && count_bits(occupancies[BOTH]) <= 32 &&
+         is_square_attacked(get_ls1b_index(bitboards[side == WHITE ? k : K]), side) == 0;
+}
+
+// parse the board, side, castling & enpassant fields (& FEN move counters) of an EPD/FEN line, returns 0 if they are
+// malformed or the position is illegal; fen gets the 4 fields (buffer of at least 520 chars)
+int
+parse_epd(char* epd, char* fen)
+{
+  char fields[4][128], line[640];
+  int  length = 0, squares = 0, ranks = 1;
+
+  *fen = 0;
+  if (sscanf(epd, "%127s %127s %127s %127s%n", fields[0], fields[1], fields[2], fields[3], &length) != 4) return 0;
+
+  for (char* c = fields[0]; *c; c++) {                                                                                 // 8 ranks of 8 squares
+    if      (strchr("PNBRQKpnbrqk", *c))            squares++;
+    else if (*c >= '1' && *c <= '8')                squares += *c - '0';
+    else if (*c == '/' && squares == 8 * ranks)     ranks++;
+    else                                            return 0;
+  }
+  if (ranks != 8 || squares != 64) return 0;
+  if (strcmp(fields[1], "w") && strcmp(fields[1], "b")) return 0;
+  if (strspn(fields[2], "KQkq-") != strlen(fields[2])) return 0;
+  if (strcmp(fields[3], "-") && (strlen(fields[3]) != 2 || fields[3][0] < 'a' || fields[3][0] > 'h' ||
+                                 (fields[3][1] != '3' && fields[3][1] != '6'))) return 0;
+
+  sprintf(fen, "%s %s %s %s", fields[0], fields[1], fields[2], fields[3]);
+  snprintf(line, sizeof(line), "%s %s", fen, epd + length + strspn(epd + length, " \t"));                              // parse_fen wants single spaces
+  parse_fen(line);
+
+  return valid_position();
 }
 
+// pack the current position into a record
+void
+pack_position(unsigned char* record, int fullmove)
+{
+  U64 occupancy = occupancies[BOTH];
 
-// Search
+  memset(record, 0, packed_size);
+  for (int byte = 0; byte < 8; byte++) record[byte] = occupancy >> (8 * byte);
 
-// These are the score bounds for the range of the mating scores
-// [-infinity, -mate_value ... -mate_score, ... score ... mate_score ...  mate_value, infinity]
+  for (int index = 0; occupancy; index++) {                                                                            // a nibble per piece in square order
+    Square square = get_ls1b_index(occupancy);
+    int    piece  = P;
+    while (get_bit(bitboards[piece], square) == 0) piece++;
+    record[8 + index / 2] |= piece << (4 * (index & 1));
+    pop_bit(occupancy, square);
+  }
 
-#define infinity   50000
-#define mate_value 49000
-#define mate_score 48000
+  record[24] = side | castle << 1;
+  record[25] = enpassant;
+  record[26] = fifty;
+  record[28] = fullmove, record[29] = fullmove >> 8;
+}
 
-// most valuable victim & less valuable attacker
+// make a record the current position, returns its full move number (-1 if the record is corrupt)
+int
+unpack_position(const unsigned char* record)
+{
+  U64 occupancy = 0ULL;
+  for (int byte = 0; byte < 8; byte++) occupancy |= (U64)record[byte] << (8 * byte);
+  if (count_bits(occupancy) > 32 || record[25] > no_sq) return -1;
+
+  memset(bitboards,   0ULL, sizeof(bitboards));
+  memset(occupancies, 0ULL, sizeof(occupancies));
+  hash_key     = 0ULL;                                                                                                 // keys are built along (no generate_hash_key pass)
+  material_key = 0ULL;
+
+  int index = 0;
+  for (Square square = 0; square < 64; square++) {                                                                     // a walk over the squares beats bit scans here
+    if (get_bit(occupancy, square) == 0) continue;
+    int piece = record[8 + index / 2] >> (4 * (index & 1)) & 15;
+    if (piece > k) return -1;
+    index++;
+
+    set_bit(bitboards[piece], square);
+    set_bit(occupancies[piece >= p], square);
+    hash_key     ^= piece_keys[piece][square];
+    material_key += material_keys[piece];
+  }
+  occupancies[BOTH] = occupancy;
+
+  side      = record[24] & 1;
+  castle    = record[24] >> 1 & 15;
+  enpassant = record[25];
+  fifty     = record[26];
+  hash_key ^= castle_keys[castle];
+  if (enpassant != no_sq) hash_key ^= enpassant_keys[enpassant];
+  if (side == BLACK)      hash_key ^= side_key;
+
+  repetition_index    = 0;                                                                                             // a record has no game history
+  repetition_table[0] = 0ULL;
+  return record[28] | record[29] << 8;
+}
 
-//    (Victims) Pawn Knight Bishop   Rook  Queen   King
-//  (Attackers)
-//        Pawn   105    205    305    405    505    605
-//      Knight   104    204    304    404    504    604
-//      Bishop   103    203    303    403    503    603
-//        Rook   102    202    302    402    502    602
-//       Queen   101    201    301    401    501    601
-//        King   100    200    300    400    500    600
+// memory map a file of packed positions, returns its records (NULL if it can't be mapped)
+unsigned char*
+map_packed_file(char* path, U64* count)
+{
+  int descriptor = open(path, O_RDONLY);
+  if (descriptor < 0) return NULL;
+
+  struct stat status;
+  fstat(descriptor, &status);
+  void* data = (status.st_size >= packed_size) ? mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, descriptor, 0) : MAP_FAILED;
+  close(descriptor);
+  if (data == MAP_FAILED) return NULL;
+
+  madvise(data, status.st_size, MADV_SEQUENTIAL);                                                                      // records are read front to back
+  *count = status.st_size / packed_size;
+  return data;
+}
 
-// MVV LVA [attacker][victim]
-static int mvv_lva[12][12] = {
-  105, 205, 305, 405, 505, 605, 105, 205, 305, 405, 505, 605, 104, 204, 304,
-  404, 504, 604, 104, 204, 304, 404, 504, 604, 103, 203, 303, 403, 503, 603,
-  103, 203, 303, 403, 503, 603, 102, 202, 302, 402, 502, 602, 102, 202, 302,
-  402, 502, 602, 101, 201, 301, 401, 501, 601, 101, 201, 301, 401, 501, 601,
-  100, 200, 300, 400, 500, 600, 100, 200, 300, 400, 500, 600,
+// stream EPD/FEN lines into packed records (pack) or packed records into FEN lines (unpack)
+void
+convert_positions(char* in_path, char* out_path, int pack)
+{
+  FILE* in  = strcmp(in_path,  "-") == 0 ? stdin  : fopen(in_path,  pack ? "r" : "rb");
+  FILE* out = strcmp(out_path, "-") == 0 ? stdout : fopen(out_path, pack ? "wb" : "w");
+  if (in == NULL || out == NULL) {
+    fprintf(stderr, "failed to open %s\n", in == NULL ? in_path : out_path);
+    return;
+  }
 
-  105, 205, 305, 405, 505, 605, 105, 205, 305, 405, 505, 605, 104, 204, 304,
-  404, 504, 604, 104, 204, 304, 404, 504, 604, 103, 203, 303, 403, 503, 603,
-  103, 203, 303, 403, 503, 603, 102, 202, 302, 402, 502, 602, 102, 202, 302,
-  402, 502, 602, 101, 201, 301, 401, 501, 601, 101, 201, 301, 401, 501, 601,
-  100, 200, 300, 400, 500, 600, 100, 200, 300, 400, 500, 600
-};
+  char          line[1024], fen[520];
+  unsigned char record[packed_size];
+  U64           converted = 0, skipped = 0;
+
+  if (pack) {
+    while (fgets(line, sizeof(line), in)) {
+      int fullmove = 1;
+      line[strcspn(line, "\r\n")] = 0;
+      if (line[strspn(line, " \t")] == 0 || line[strspn(line, " \t")] == '#') continue;                                // blank lines & comments
+      if (parse_epd(line, fen) == 0) { skipped++; continue; }
+      sscanf(line, "%*s %*s %*s %*s %*d %d", &fullmove);
+      pack_position(record, fullmove);
+      fwrite(record, packed_size, 1, out);
+      converted++;
+    }
+  }
+  else {
+    while (fread(record, packed_size, 1, in) == 1) {
+      int fullmove = unpack_position(record);
+      if (fullmove < 0) { skipped++; continue; }
+      generate_fen(fen, fullmove);
+      fprintf(out, "%s\n", fen);
+      converted++;
+    }
+  }
 
-#define max_ply 64                                                                                                     /* max ply that we can reach within a search */
+  fprintf(stderr, "info string converted %lld positions, skipped %lld\n", converted, skipped);
+  if (in  != stdin)  fclose(in);
+  if (out != stdout) fclose(out);
+}
 
-int killer_moves[2][max_ply];                                                                                          // killer moves [id][ply]
-int history_moves[12][64];                                                                                             // history moves [piece][square]
+// perft of every position of a packed file (move generator throughput over a data set)
+void
+perft_file(char* path, int depth)
+{
+  U64            count;
+  unsigned char* records = map_packed_file(path, &count);
+  if (records == NULL) {
+    fprintf(stderr, "failed to map %s\n", path);
+    return;
+  }
 
-//      ================================
-//            Triangular PV table
-//      --------------------------------
-//        PV line: e2e4 e7e5 g1f3 b8c6
-//      ================================
-//
-//           0    1    2    3    4    5
-//
-//      0    m1   m2   m3   m4   m5   m6
-//
-//      1    0    m2   m3   m4   m5   m6
-//
-//      2    0    0    m3   m4   m5   m6
-//
-//      3    0    0    0    m4   m5   m6
-//
-//      4    0    0    0    0    m5   m6
-//
-//      5    0    0    0    0    0    m6
+  U64 total = 0, positions = 0;
+  int start = get_time_ms();
+  for (U64 index = 0; index < count; index++) {
+    if (unpack_position(records + index * packed_size) < 0 || valid_position() == 0) continue;
+    nodes = 0;
+    perft_driver(depth);
+    total += nodes;
+    positions++;
+  }
+  int elapsed = get_time_ms() - start;
+
+  printf("     Positions: %lld\n", positions);
+  printf("         Depth: %d\n",   depth);
+  printf("         Nodes: %lld\n", total);
+  printf("          Time: %d\n",   elapsed);
+  printf("           NPS: %lld\n\n", total * 1000 / (elapsed + 1));
+  munmap(records, count * packed_size);
+}
 
-int pv_length[max_ply];                                                                                                // PV length [ply]
-int pv_table[max_ply][max_ply];                                                                                        // PV table [ply][ply]
-int follow_pv, score_pv;                                                                                               // follow PV & score PV move
+// Batch analysis
 
-// Transposition table
-#define hash_size       800000                                                                                         /* hash table size (would be around 20MB) */
-#define no_hash_entry   100000                                                                                         /* no hash entry found constant */
-#define hash_flag_exact 0                                                                                              /* transposition table hash flags */
-#define hash_flag_alpha 1
-#define hash_flag_beta  2
+// "bbc batch <file or -> [depth] [threads] [json|csv]" analyses the EPD/FEN lines of a file (or stdin) on a pool of
+// worker threads & streams a result line per position as soon as it is done (so results may come out of order; "index"
+// is the input line or record number). Files named *.packed are memory mapped & read as packed positions. Every worker
+// has its own board & search state (those globals are _Thread_local), while the transposition table & eval cache are
+// shared between them like the read only tables.
 
-typedef struct                                                                                                         // transposition table data structure
-{
-  U64 hash_key;                                                                                                        // "almost" unique chess position identifier
-  int depth;                                                                                                           // current search depth
-  int flag;                                                                                                            // flag the type of node (fail-low/fail-high/PV)
-  int score;                                                                                                           // score (alpha/beta/PV)
-} tt;                                                                                                                  // transposition table (TT aka hash table)
+#define batch_default_depth 8                                                                                          /* search depth per position */
 
-tt hash_table[hash_size];                                                                                              // define TT instance
+pthread_mutex_t batch_lock = PTHREAD_MUTEX_INITIALIZER;                                                                // guards the input & the totals
+FILE*           batch_input;                                                                                           // EPD/FEN lines
+unsigned char*  batch_records;                                                                                         // or packed positions
+U64             batch_record_count;                                                                                    // & their count
+int             batch_depth;                                                                                           // search depth per position
+int             batch_csv;                                                                                             // print CSV instead of JSON lines
+int             batch_lines;                                                                                           // input lines read
+int             batch_positions;                                                                                       // positions analysed
+U64             batch_nodes;                                                                                           // & their nodes
 
-// clear TT (hash table)
+// print a batch result ("error" instead of a move if the position can't be analysed)
 void
-clear_hash_table()
+batch_print(int index, char* id, char* fen, char* move, int elapsed)
 {
-  for (int index = 0; index < hash_size; index++) {                                                                    // loop over TT elements
-    hash_table[index].hash_key = 0;                                                                                    // reset TT inner fields
-    hash_table[index].depth    = 0;
-    hash_table[index].flag     = 0;
-    hash_table[index].score    = 0;
+  char* type  = "cp";
+  int   score = search_score;
+  if      (search_score > -mate_value && search_score < -mate_score) type = "mate", score = -(search_score + mate_value) / 2 - 1;
+  else if (search_score >  mate_score && search_score <  mate_value) type = "mate", score =  (mate_value - search_score) / 2 + 1;
+
+  if (strcmp(move, "error") == 0) {
+    if (batch_csv) printf("%d,%s,%s,,error,,,,\n", index, id, fen);
+    else           printf("{\"index\":%d,\"id\":\"%s\",\"fen\":\"%s\",\"error\":\"invalid position\"}\n", index, id, fen);
   }
+  else if (batch_csv)
+    printf("%d,%s,%s,%s,%s,%d,%d,%lld,%d\n", index, id, fen, move, type, score, search_depth, nodes, elapsed);
+  else
+    printf("{\"index\":%d,\"id\":\"%s\",\"fen\":\"%s\",\"bestmove\":\"%s\",\"%s\":%d,\"depth\":%d,\"nodes\":%lld,\"time\":%d}\n",
+           index, id, fen, move, type, score, search_depth, nodes, elapsed);
+  fflush(stdout);
 }
 
-// read hash entry data
-int
-read_hash_entry(int alpha, int beta, int depth)
+// worker thread: analyse input lines until there are none left
+void*
+batch_worker(void* unused)
 {
-  tt* hash_entry = &hash_table[hash_key % hash_size];                                                                  // create a TT instance pointer to particular hash entry storing
-                                                                                                                       // the scoring data for the current board position if available
-  if (hash_entry->hash_key == hash_key) {                                                                              // make sure we're dealing with the exact position we need
-    if (hash_entry->depth >= depth) {                                                                                  // make sure that we match the exact depth our search is now at
-      int score = hash_entry->score;                                                                                   // extract stored score from TT entry
-      if (score < -mate_score) score += ply;                                                                           // retrieve score independent from the actual path
-      if (score > mate_score)  score -= ply;                                                                           // from root node (position) to current node (position)
-      if (hash_entry->flag  == hash_flag_exact)                                                                        // match the exact (PV node) score
-        return score;                                                                                                  // return exact (PV node) score
-      if ((hash_entry->flag == hash_flag_alpha) && (score <= alpha))                                                   // match alpha (fail-low node) score
-        return alpha;                                                                                                  // return alpha (fail-low node) score
-      if ((hash_entry->flag == hash_flag_beta) && (score >= beta))                                                     // match beta (fail-high node) score
-        return beta;                                                                                                   // return beta (fail-high node) score
+  (void)unused;
+  gui_input = 0;                                                                                                       // stdin might be the batch input
+  verbose   = 0;
+  grow_repetition_table();                                                                                             // this thread's repetition table
+
+  char line[1024];
+  while (1) {
+    pthread_mutex_lock(&batch_lock);
+    int   index = ++batch_lines;
+    char* read  = batch_records ? ((U64)index <= batch_record_count ? line : NULL) : fgets(line, sizeof(line), batch_input);
+    pthread_mutex_unlock(&batch_lock);
+    if (read == NULL) break;
+
+    char id[256] = "", fen[520] = "";
+    int  valid;
+
+    if (batch_records) {                                                                                               // packed position
+      int fullmove = unpack_position(batch_records + (U64)(index - 1) * packed_size);
+      valid = fullmove >= 0 && valid_position();
+      if (valid) generate_fen(fen, fullmove);
+    }
+    else {                                                                                                             // EPD/FEN line
+      line[strcspn(line, "\r\n")] = 0;                                                                                 // strip line end
+      char* epd = line + strspn(line, " \t");
+      if (*epd == 0 || *epd == '#') continue;                                                                          // skip blank lines & comments
+
+      char* opcode = strstr(epd, "id \"");                                                                             // EPD "id" operation
+      if (opcode) sscanf(opcode + 4, "%255[^\"\\]", id);
+      valid = parse_epd(epd, fen);
+    }
+
+    if (valid == 0) {
+      search_score = search_depth = nodes = 0;
+      batch_print(index, id, fen, "error", 0);
+      continue;
     }
+
+    starttime = get_time_ms();
+    search_position(batch_depth);
+    int elapsed = get_time_ms() - starttime;
+
+    char move[8];
+    move_to_string(search_move, move);                                                                                 // UCI null move if there is no legal move
+    batch_print(index, id, fen, move, elapsed);
+
+    pthread_mutex_lock(&batch_lock);
+    batch_positions++;
+    batch_nodes += nodes;
+    pthread_mutex_unlock(&batch_lock);
   }
-  return no_hash_entry;                                                                                                // if hash entry doesn't exist
+
+  free(repetition_table);
+  return NULL;
 }
 
-// write hash entry data
+// analyse all positions of a file ("-" for stdin) with the given number of worker threads
 void
-write_hash_entry(int score, int depth, int hash_flag)
+batch(char* path, int depth, int threads, int csv)
 {
-  tt* hash_entry = &hash_table[hash_key % hash_size];                                                                  // create a TT instance pointer to particular hash entry storing
-                                                                                                                       // the scoring data for the current board position if available
-  if (score < -mate_score) score -= ply;                                                                               // store score independent from the actual path
-  if (score > mate_score)  score += ply;                                                                               // from root node (position) to current node (position)
+  int length = strlen(path), extension = strlen(packed_extension);
+  if (length > extension && strcmp(path + length - extension, packed_extension) == 0)
+    batch_records = map_packed_file(path, &batch_record_count);
+  else
+    batch_input   = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+  if (batch_input == NULL && batch_records == NULL) {
+    fprintf(stderr, "failed to open %s\n", path);
+    return;
+  }
+  batch_depth = depth > 0 ? depth : batch_default_depth;
+  batch_csv   = csv;
+  if (threads < 1) threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads < 1) threads = 1;
+
+  if (batch_csv) printf("index,id,fen,bestmove,score_type,score,depth,nodes,time_ms\n");
+
+  pthread_t* workers = malloc(threads * sizeof(pthread_t));
+  pthread_attr_t attributes;
+  pthread_attr_init(&attributes);
+  pthread_attr_setstacksize(&attributes, 32 << 20);                                                                    // room for the search & the thread's _Thread_local state
+
+  int start = get_time_ms();
+  int started = 0;
+  while (started < threads && pthread_create(&workers[started], &attributes, batch_worker, NULL) == 0) started++;      // fewer workers if the system refuses more
+  if (started == 0) fprintf(stderr, "failed to start a batch worker thread\n");
+  threads = started;                                                                                                   // join only the threads that exist
+  for (int thread = 0; thread < threads; thread++) pthread_join(workers[thread], NULL);
+  int elapsed = get_time_ms() - start;
+
+  fprintf(stderr, "info string batch %d positions %d threads %lld nodes %d ms %lld nps\n",
+          batch_positions, threads, batch_nodes, elapsed, batch_nodes * 1000 / (elapsed + 1));
+
+  pthread_attr_destroy(&attributes);
+  free(workers);
+  if (batch_records)                               munmap(batch_records, batch_record_count * packed_size);
+  else if (batch_input != stdin)                   fclose(batch_input);
+}
+
+//        UCI
+//  forked from VICE
+// by Richard Allbert
+
+typedef struct                                                                                                         // UCI spin option
+{
+  char const* name;                                                                                                    // option name as seen by the GUI
+  int*        value;                                                                                                   // engine variable controlled by the option
+  int         min;                                                                                                     // lower bound
+  int         max;                                                                                                     // upper bound
+} spin_option;
+
+spin_option spin_options[] = {                                                                                         // search parameters tunable via "setoption"
+  { "RFPDepth",             &default_parameters.rfp_depth,           0,   16 },
+  { "RFPMargin",            &default_parameters.rfp_margin,          0, 1000 },
+  { "RazorDepth",           &default_parameters.razor_depth,         0,   16 },
+  { "RazorMargin",          &default_parameters.razor_margin,        0, 1000 },
+  { "FutilityDepth",        &default_parameters.futility_depth,      0,   16 },
+  { "FutilityMargin",       &default_parameters.futility_margin,     0, 1000 },
+  { "LMPDepth",             &default_parameters.lmp_depth,           0,   16 },
+  { "LMPBase",              &default_parameters.lmp_base,            0,  256 },
+  { "NullMoveDepth",        &default_parameters.nmp_depth,           1,   16 },
+  { "NullMoveBase",         &default_parameters.nmp_base,            0,    8 },
+  { "NullMoveDepthDivisor", &default_parameters.nmp_depth_divisor,   1,   16 },
+  { "NullMoveEvalDivisor",  &default_parameters.nmp_eval_divisor,   10, 1000 },
+  { "NullMoveVerifyDepth",  &default_parameters.nmp_verify_depth,    1,  128 },
+  { "DeltaMargin",          &default_parameters.delta_margin,        0, 2000 },
+  { "IIRDepth",             &default_parameters.iir_depth,           2,  128 },
+  { "LMRBase",              &default_parameters.lmr_base,            0,  500 },
+  { "LMRDivisor",           &default_parameters.lmr_divisor,        50, 1000 },
+  { "MultiPV",              &multi_pv,                               1, max_multi_pv },
+  { "EvalCache",            &eval_cache_mb,                          1, 1024 },
+  { "LazyMargin",           &lazy_margin,                            0, 1000 },
+  { "SyzygyProbeLimit",     &tb_probe_limit,                         0, tb_pieces },
+};
 
-  hash_entry->hash_key = hash_key;                                                                                     // write hash entry data
-  hash_entry->score    = score;
-  hash_entry->flag     = hash_flag;
-  hash_entry->depth    = depth;
+#define spin_options_count (int)(sizeof(spin_options) / sizeof(spin_options[0]))
+
+// print UCI options
+void
+print_options()
+{
+  for (int index = 0; index < spin_options_count; index++)                                                             // loop over spin options
+    printf("option name %s type spin default %d min %d max %d\n",
+           spin_options[index].name,
+           *spin_options[index].value,
+           spin_options[index].min,
+           spin_options[index].max);
+
+  printf("option name UseNNUE type check default false\n");                                                            // NNUE evaluation
+  printf("option name EvalFile type string default <empty>\n");
+  printf("option name SyzygyPath type string default <empty>\n");                                                      // tablebases
+  printf("option name OwnBook type check default false\n");                                                            // opening book
+  printf("option name BookFile type string default <empty>\n");
 }
 
-// enable PV move scoring
+// parse UCI "setoption" command (e.g. "setoption name RFPMargin value 150")
 void
-enable_pv_scoring(moves* move_list)
+parse_setoption(char* command)
 {
-  follow_pv = 0;                                                                                                       // disable following PV
+  char* name  = strstr(command, "name ");                                                                              // option name
+  char* value = strstr(command, " value ");                                                                            // option value
 
-  for (int count = 0; count < move_list->count; count++) {                                                             // loop over the moves within a move list
-    if (pv_table[0][ply] == move_list->moves[count]) {                                                                 // make sure we hit PV move
-      score_pv = 1;                                                                                                    // enable move scoring
-      follow_pv = 1;                                                                                                   // enable following PV
+  if (name == NULL || value == NULL) return;                                                                           // malformed command
+  name += 5;
+
+  for (int index = 0; index < spin_options_count; index++) {                                                           // loop over spin options
+    int length = strlen(spin_options[index].name);
+
+    if (strncmp(name, spin_options[index].name, length) == 0 && name[length] == ' ') {                                 // option name matches
+      int option = atoi(value + 7);                                                                                    // parse option value
+      if (option < spin_options[index].min) option = spin_options[index].min;                                          // clamp it into option bounds
+      if (option > spin_options[index].max) option = spin_options[index].max;
+      *spin_options[index].value = option;
     }
   }
-}
 
-//  =======================
-//       Move ordering
-//  =======================
-//  1. PV move
-//  2. Captures in MVV/LVA
-//  3. 1st killer move
-//  4. 2nd killer move
-//  5. History moves
-//  6. Unsorted moves
+  if (strncmp(name, "EvalFile ", 9) == 0) {                                                                            // load NNUE weights
+    char* path = value + 7;
+    path[strcspn(path, "\r\n")] = 0;                                                                                   // strip line end
+    if (nnue_load(path)) printf("info string NNUE loaded from %s\n", path);
+    else                 printf("info string failed to load NNUE from %s\n", path);
+    use_nnue = use_nnue && nnue_loaded;
+    clear_eval_cache();                                                                                                // cached scores came from the old weights
+  }
 
-// score moves
+  if (strncmp(name, "SyzygyPath ", 11) == 0) {                                                                         // load tablebases
+    char* path = value + 7;
+    path[strcspn(path, "\r\n")] = 0;                                                                                   // strip line end
+    tb_init(path);
+  }
+
+  if (strncmp(name, "BookFile ", 9) == 0) {                                                                            // map opening book
+    char* path = value + 7;
+    path[strcspn(path, "\r\n")] = 0;                                                                                   // strip line end
+    book_init(path);
+  }
+
+  if (strncmp(name, "OwnBook ", 8) == 0) own_book = strncmp(value + 7, "true", 4) == 0;                                // switch opening book
+
+  if (strncmp(name, "UseNNUE ", 8) == 0) {                                                                             // switch evaluation
+    use_nnue = strncmp(value + 7, "true", 4) == 0;
+    if (use_nnue && nnue_loaded == 0) {
+      printf("info string no NNUE loaded (set EvalFile first)\n");
+      use_nnue = 0;
+    }
+    if (use_nnue) nnue_refresh();
+    clear_eval_cache();                                                                                                // cached scores came from the other evaluation
+  }
+
+  init_lmr_table();                                                                                                    // LMR parameters might have changed
+  init_eval_cache();                                                                                                   // so might eval cache size
+}
+
+// parse user/GUI move string input (e.g. "e7e8q")
 int
-score_move(int move)
+parse_move(char* move_string)
 {
-  if (score_pv) {                                                                                                      // if PV move scoring is allowed
-    if (pv_table[0][ply] == move) {                                                                                    // make sure we are dealing with PV move
-      score_pv = 0;                                                                                                    // disable score PV flag
-      return 20000;                                                                                                    // give PV move the highest score to search it first
+  moves move_list[1];                                                                                                  // create move list instance
+  generate_moves(move_list);                                                                                           // generate moves
+
+  int source_square = (move_string[0] - 'a') + (8 - (move_string[1] - '0')) * 8;                                       // parse source square
+  int target_square = (move_string[2] - 'a') + (8 - (move_string[3] - '0')) * 8;                                       // parse target square
+
+  for (int move_count = 0; move_count < move_list->count; move_count++) {                                              // loop over the moves within a move list
+    int move = move_list->moves[move_count];                                                                           // init move
+
+    if (source_square == get_move_source(move) &&                                                                      // make sure source & target squares are available within the generated move
+        target_square == get_move_target(move)) {
+      int promoted_piece = get_move_promoted(move);                                                                    // init promoted piece
+
+      if (promoted_piece) {                                                                                            // promoted piece is available
+        if      ((promoted_piece == Q || promoted_piece == q) && move_string[4] == 'q') return move;                   // promoted to queen
+        else if ((promoted_piece == R || promoted_piece == r) && move_string[4] == 'r') return move;                   // promoted to rook
+        else if ((promoted_piece == B || promoted_piece == b) && move_string[4] == 'b') return move;                   // promoted to bishop
+        else if ((promoted_piece == N || promoted_piece == n) && move_string[4] == 'n') return move;                   // promoted to knight
+        continue;                                                                                                      // continue the loop on possible wrong promotions (e.g. "e7e8f")
+      }
+      return move;                                                                                                     // return legal move
     }
   }
+  return 0;                                                                                                            // return illegal move
+}
 
-  if (get_move_capture(move)) {                                                                                        // score capture move
-    int target_piece = P;                                                                                              // init target piece
+// Self-play match
+
+// "bbc match <openings> [games] [nodes|<ms>ms] [threads] [test] [base] [elo0] [elo1]" plays games between two
+// configurations of the engine on a pool of worker threads, each game on its worker's own board. The configurations are
+// lists of search parameters like "RFPMargin=150,LMRBase=80" ("-" for the defaults), switched per move; the other spin
+// options (MultiPV, EvalCache, LazyMargin, SyzygyProbeLimit) would apply to both engines and are refused. Every opening
+// of the EPD/FEN (or *.packed) file is played twice with colors reversed, each move searched to a node limit (or for a
+// fixed time). Games end by mate, stalemate, the fifty move rule, threefold repetition, a recognized draw, resignation
+// (both engines see the same side at least match_resign_score ahead for match_resign_moves moves) or as a draw after
+// match_max_plies. The match stops as soon as the SPRT accepts a hypothesis: H0 "test is elo0 stronger than base" or H1
+// "test is elo1 stronger" (alpha = beta = 0.05). Each engine has a transposition table of its own (shared by the
+// workers) & its own history tables in every worker; only the eval cache is common, as both engines evaluate alike.
+
+#define match_default_games 1000                                                                                       /* games to play if the SPRT doesn't stop earlier */
+#define match_default_nodes 10000                                                                                      /* nodes per move */
+#define match_max_plies      400                                                                                       /* longer games are adjudicated as draws */
+#define match_resign_score  1000                                                                                       /* resignation threshold (centipawns) */
+#define match_resign_moves     4                                                                                       /* moves each engine must agree on it */
+#define match_report_games   100                                                                                       /* games between progress reports */
+#define match_sprt_bound     2.944438979                                                                               /* ln((1 - beta) / alpha) */
+
+pthread_mutex_t   match_lock = PTHREAD_MUTEX_INITIALIZER;                                                              // guards the game counter & the results
+search_parameters match_engines[2];                                                                                    // test & base configurations
+char**            match_openings;                                                                                      // opening FENs
+int               match_opening_count;                                                                                 // & their count
+int               match_games;                                                                                         // games to play
+U64               match_nodes;                                                                                         // node limit per move
+int               match_movetime;                                                                                      // or time per move (ms)
+int               match_started;                                                                                       // games handed out to the workers
+int               match_wins, match_draws, match_losses;                                                               // results of the test engine
+double            match_elo0, match_elo1;                                                                              // SPRT hypotheses
+int               match_stop;                                                                                          // SPRT has accepted H1 (1) or H0 (-1)
+U64               match_total_nodes;                                                                                   // nodes searched in all games
+
+// natural logarithm (x > 0) without libm: ln(x) = 2 atanh((x - 1) / (x + 1)) after scaling x into [1, 2)
+double
+log_double(double x)
+{
+  int exponent = 0;
+  while (x >= 2) x /= 2, exponent++;
+  while (x <  1) x *= 2, exponent--;
 
-    int start_piece, end_piece;                                                                                        // pick up bitboard piece index ranges depending on side
+  double y = (x - 1) / (x + 1), term = y, sum = 0;
+  for (int power = 1; power < 40; power += 2) sum += term / power, term *= y * y;
 
-    if (side == WHITE) {                                                                                               // pick up side to move
-      start_piece = p;
-      end_piece = k;
-    } else {
-      start_piece = P;
-      end_piece = K;
-    }
+  return 2 * sum + exponent * 0.693147180559945309;
+}
 
-    for (int bb_piece = start_piece; bb_piece <= end_piece; bb_piece++) {                                              // loop over bitboards opposite to the current side to move
-      if (get_bit(bitboards[bb_piece], get_move_target(move))) {                                                       // if there's a piece on the target square
-        target_piece = bb_piece;                                                                                       // remove it from corresponding bitboard
-        break;
+// e^x without libm: Taylor series of x / 2^k squared k times
+double
+exp_double(double x)
+{
+  int halvings = 0;
+  while (x > 0.5 || x < -0.5) x /= 2, halvings++;
+
+  double sum = 1, term = 1;
+  for (int power = 1; power < 20; power++) term *= x / power, sum += term;
+  while (halvings--) sum *= sum;
+
+  return sum;
+}
+
+// square root without libm (Newton's method)
+double
+sqrt_double(double x)
+{
+  if (x <= 0) return 0;
+  double root = x > 1 ? x : 1;
+  for (int iteration = 0; iteration < 100; iteration++) root = (root + x / root) / 2;
+  return root;
+}
+
+// expected score of an Elo difference
+double
+elo_to_score(double elo)
+{
+  return 1 / (1 + exp_double(-elo * log_double(10) / 400));
+}
+
+// Elo difference of an expected score (clamped into 0.1% .. 99.9%)
+double
+score_to_elo(double score)
+{
+  if (score < 0.001) score = 0.001;
+  if (score > 0.999) score = 0.999;
+  return -400 * log_double(1 / score - 1) / log_double(10);
+}
+
+// log likelihood ratio of H1 against H0 for the results so far (normal approximation of the trinomial GSPRT)
+double
+match_llr()
+{
+  int    games    = match_wins + match_draws + match_losses;
+  double score    = (match_wins + match_draws / 2.0) / games;
+  double variance = (match_wins + match_draws / 4.0) / games - score * score;                                          // variance of a game's result
+  if (variance <= 0) return 0;                                                                                         // no decisive game yet (or no draw or loss)
+
+  double score0 = elo_to_score(match_elo0), score1 = elo_to_score(match_elo1);
+  return games * (score1 - score0) * (2 * score - score0 - score1) / (2 * variance);
+}
+
+// print the results so far
+void
+match_report()
+{
+  int    games     = match_wins + match_draws + match_losses;
+  double score     = (match_wins + match_draws / 2.0) / games;
+  double deviation = sqrt_double(((match_wins + match_draws / 4.0) / games - score * score) / games);                  // standard error of the score
+  double elo       = score_to_elo(score);
+  double margin    = (score_to_elo(score + 1.96 * deviation) - score_to_elo(score - 1.96 * deviation)) / 2;            // 95% confidence
+
+  printf("games %d wins %d draws %d losses %d score %.1f%% elo %.1f +/- %.1f llr %.2f (%.2f, %.2f) [%.1f, %.1f]\n",
+         games, match_wins, match_draws, match_losses, 100 * score, elo, margin, match_llr(),
+         -match_sprt_bound, match_sprt_bound, match_elo0, match_elo1);
+  fflush(stdout);
+}
+
+// play a game from an opening with engine white (0 test, 1 base) as White, returns White's result (1, 0 or -1)
+int
+match_game(char* opening, int white, U64* searched)
+{
+  char line[640], fen[520];
+  snprintf(line, sizeof(line), "%s", opening);
+  repetition_index = 0;
+  parse_epd(line, fen);
+
+  int ahead = 0;                                                                                                       // consecutive moves with White (> 0) or Black (< 0) clearly ahead
+
+  for (int plies = 0; ; plies++) {
+    moves move_list[1];
+    generate_moves(move_list);
+    int first_legal = 0;
+    for (int count = 0; count < move_list->count && first_legal == 0; count++) {                                       // find a legal move
+      copy_board();
+      if (make_move(move_list->moves[count], all_moves)) {
+        take_back();
+        first_legal = move_list->moves[count];
       }
     }
+    if (first_legal == 0) {                                                                                            // mate or stalemate
+      int in_check = is_square_attacked(get_ls1b_index(bitboards[side == WHITE ? K : k]), side ^ 1);
+      return in_check ? (side == WHITE ? -1 : 1) : 0;
+    }
 
-    return mvv_lva[get_move_piece(move)][target_piece] + 10000;                                                        // score move by MVV LVA lookup [source piece][target piece]
+    int repeated = 0, last = repetition_index - fifty + 1;                                                             // earlier occurrences of the position (see is_repetition)
+    for (int index = repetition_index - 1; index >= (last > 1 ? last : 1); index -= 2)
+      repeated += repetition_table[index] == hash_key;
+    if (fifty >= 100 || repeated >= 2 || is_endgame_draw(probe_material()) || plies >= match_max_plies) return 0;
+
+    engine     = side == WHITE ? white : white ^ 1;                                                                    // engine to move: its parameters, TT & histories
+    parameters = &match_engines[engine];
+    stopnodes  = match_nodes;
+    timeset    = match_movetime > 0;
+    starttime  = get_time_ms();
+    stoptime   = starttime + match_movetime;
+    search_position(max_ply);
+    *searched += nodes;
+
+    int move  = search_move ? search_move : first_legal;                                                               // stopped before the first iteration completed
+    int score = side == WHITE ? search_score : -search_score;                                                          // White's point of view
+    if      (score >=  match_resign_score) ahead = ahead > 0 ? ahead + 1 :  1;
+    else if (score <= -match_resign_score) ahead = ahead < 0 ? ahead - 1 : -1;
+    else                                   ahead = 0;
+    if (ahead >= 2 * match_resign_moves || ahead <= -2 * match_resign_moves) return ahead > 0 ? 1 : -1;                // both engines agree: resign
+
+    grow_repetition_table();
+    repetition_index++;
+    repetition_table[repetition_index] = hash_key;
+    make_move(move, all_moves);
   }
+}
 
-  else {                                                                                                               // score quiet move
-    if      (killer_moves[0][ply] == move) return 9000;                                                                // score 1st killer move
-    else if (killer_moves[1][ply] == move) return 8000;                                                                // score 2nd killer move
-    else                                   return history_moves[get_move_piece(move)][get_move_target(move)];          // score history move
+// worker thread: play games until all are played or the SPRT has stopped the match
+void*
+match_worker(void* unused)
+{
+  (void)unused;
+  gui_input = 0;
+  verbose   = 0;
+  grow_repetition_table();                                                                                             // this thread's repetition table
+
+  while (1) {
+    pthread_mutex_lock(&match_lock);
+    int game = match_stop ? match_games : match_started;
+    if (game < match_games) match_started++;
+    pthread_mutex_unlock(&match_lock);
+    if (game >= match_games) break;
+
+    U64 searched = 0;
+    int white    = game & 1;                                                                                           // openings are played with both colors
+    int result   = match_game(match_openings[game / 2 % match_opening_count], white, &searched);
+    if (white) result = -result;                                                                                       // test engine's point of view
+
+    pthread_mutex_lock(&match_lock);
+    if      (result > 0) match_wins++;
+    else if (result < 0) match_losses++;
+    else                 match_draws++;
+    match_total_nodes += searched;
+
+    int    games = match_wins + match_draws + match_losses;
+    double llr   = match_llr();
+    if (match_stop == 0 && llr >=  match_sprt_bound) match_stop =  1;                                                  // games still being played are counted,
+    if (match_stop == 0 && llr <= -match_sprt_bound) match_stop = -1;                                                  // but don't change the verdict
+    if (games % match_report_games == 0 && games < match_games && match_stop == 0) match_report();
+    pthread_mutex_unlock(&match_lock);
   }
 
-  return 0;
+  free(repetition_table);
+  return NULL;
 }
 
-// sort moves in descending order
+// parse a configuration ("Name=value,Name=value" or "-") into an engine's search parameters, returns 0 if invalid
+int
+match_engine(search_parameters* engine, char* options)
+{
+  search_parameters defaults = default_parameters;                                                                     // options are applied through "setoption"
+  char copy[1024], command[1200];
+  int  valid = 1;
+
+  snprintf(copy, sizeof(copy), "%s", strcmp(options, "-") ? options : "");
+  for (char* option = strtok(copy, ","); option; option = strtok(NULL, ",")) {
+    char* value = strchr(option, '=');
+    int   known = 0, searched = 0;
+    if (value) *value++ = 0;
+    for (int index = 0; index < spin_options_count; index++) {
+      if (strcmp(option, spin_options[index].name)) continue;
+      known    = 1;
+      searched = spin_options[index].value >= (int*)&default_parameters &&                                             // part of search_parameters, the only options
+                 spin_options[index].value <  (int*)(&default_parameters + 1);                                         // an engine of the match keeps to itself
+    }
+    if (value == NULL || known == 0) {
+      fprintf(stderr, "unknown option %s\n", option);
+      valid = 0;
+      continue;
+    }
+    if (searched == 0) {
+      fprintf(stderr, "option %s is shared by both engines, not a search parameter\n", option);
+      valid = 0;
+      continue;
+    }
+    snprintf(command, sizeof(command), "setoption name %s value %s", option, value);
+    parse_setoption(command);
+  }
+
+  *engine            = default_parameters;
+  default_parameters = defaults;
+  return valid;
+}
+
+// read the opening positions of an EPD/FEN or packed file, returns their count
 int
-sort_moves(moves* move_list)
+match_load_openings(char* path)
+{
+  char line[1024], fen[520];
+  int  length = strlen(path), extension = strlen(packed_extension), capacity = 0;
+  U64  count = 0;
+
+  unsigned char* records = length > extension && strcmp(path + length - extension, packed_extension) == 0
+                         ? map_packed_file(path, &count) : NULL;
+  FILE*          input   = records ? NULL : fopen(path, "r");
+  if (records == NULL && input == NULL) return 0;
+
+  for (U64 index = 0; records ? index < count : fgets(line, sizeof(line), input) != NULL; index++) {
+    int valid;
+    if (records) {                                                                                                     // packed position
+      int fullmove = unpack_position(records + index * packed_size);
+      valid = fullmove >= 0 && valid_position();
+      if (valid) generate_fen(fen, fullmove);
+    }
+    else {                                                                                                             // EPD/FEN line
+      line[strcspn(line, "\r\n")] = 0;
+      char* epd = line + strspn(line, " \t");
+      if (*epd == 0 || *epd == '#') continue;                                                                          // skip blank lines & comments
+      valid = parse_epd(epd, fen);
+    }
+    if (valid == 0) continue;
+
+    if (match_opening_count == capacity) {
+      capacity       = capacity ? 2 * capacity : 256;
+      match_openings = realloc(match_openings, capacity * sizeof(char*));
+    }
+    match_openings[match_opening_count++] = strdup(fen);
+  }
+
+  if (records) munmap(records, count * packed_size);
+  else         fclose(input);
+  return match_opening_count;
+}
+
+// play a match between two configurations with the given number of worker threads
+void
+match(char* path, int games, char* limit, int threads, char* test, char* base, double elo0, double elo1)
+{
+  if (match_engine(&match_engines[0], test) == 0 || match_engine(&match_engines[1], base) == 0) return;
+  if (match_load_openings(path) == 0) {
+    fprintf(stderr, "no openings in %s\n", path);
+    return;
+  }
+  clear_hash_table();                                                                                                  // test engine's TT
+  hash_tables[1] = calloc(hash_size, sizeof(tt));                                                                      // base engine's TT
+  if (hash_tables[1] == NULL) {
+    fprintf(stderr, "failed to allocate the base engine's hash table\n");
+    return;
+  }
+  match_games    = games > 0 ? games : match_default_games;
+  match_nodes    = limit && strstr(limit, "ms") == NULL ? atoll(limit) : 0;
+  match_movetime = limit && strstr(limit, "ms")         ? atoi(limit)  : 0;
+  if (match_nodes == 0 && match_movetime == 0) match_nodes = match_default_nodes;
+  match_elo0     = elo0;
+  match_elo1     = elo1;
+  if (threads < 1) threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads < 1) threads = 1;
+
+  pthread_t* workers = malloc(threads * sizeof(pthread_t));
+  pthread_attr_t attributes;
+  pthread_attr_init(&attributes);
+  pthread_attr_setstacksize(&attributes, 32 << 20);                                                                    // room for the search & the thread's _Thread_local state
+
+  int start = get_time_ms();
+  int started = 0;
+  while (started < threads && pthread_create(&workers[started], &attributes, match_worker, NULL) == 0) started++;      // fewer workers if the system refuses more
+  if (started == 0) fprintf(stderr, "failed to start a match worker thread\n");
+  threads = started;                                                                                                   // join only the threads that exist
+  for (int thread = 0; thread < threads; thread++) pthread_join(workers[thread], NULL);
+  int elapsed = get_time_ms() - start;
+
+  if (threads) {                                                                                                       // games were played
+    match_report();
+    printf("%s\n", match_stop > 0 ? "H1 accepted" : match_stop < 0 ? "H0 accepted" : "inconclusive");
+  }
+  fprintf(stderr, "info string match %d openings %d threads %lld nodes %d ms %lld nps\n",
+          match_opening_count, threads, match_total_nodes, elapsed, match_total_nodes * 1000 / (elapsed + 1));
+
+  pthread_attr_destroy(&attributes);
+  free(workers);
+  for (int index = 0; index < match_opening_count; index++) free(match_openings[index]);
+  free(match_openings);
+  free(hash_tables[1]);
+  hash_tables[1] = NULL;
+}
+
+// init all variables
+void
+init_all()
 {
-  int move_scores[move_list->count];                                                                                   // move scores
+  init_leapers_attacks();                                                                                              // init leaper pieces attacks
+  init_sliders_attacks(BISHOP);                                                                                        // init slider pieces attacks
+  init_sliders_attacks(ROOK);
+  init_random_keys();                                                                                                  // init random keys for hashing purposes
+  init_between_squares();                                                                                              // init squares between two squares
+  init_cuckoo_tables();                                                                                                // init upcoming repetition detection
+  grow_repetition_table();                                                                                             // allocate repetition table
+  clear_hash_table();                                                                                                  // clear hash table
+  init_evaluation_masks();                                                                                             // init evaluation masks
+  init_kpk_bitbase();                                                                                                  // init KPK bitbase
+  init_tb_tables();                                                                                                    // init tablebase index tables
+  init_lmr_table();                                                                                                    // init late move reductions
+  init_eval_cache();                                                                                                   // allocate eval cache
+}
+
+// Library API
 
-  for (int count = 0; count < move_list->count; count++)                                                               // score all the moves within a move list
-    move_scores[count] = score_move(move_list->moves[count]);                                                          // score move
+// The bbc_* functions declared in bbc.h. A bbc_position keeps the board state after each move of its game; every call
+// restores the current one into the calling thread's (_Thread_local) board & repetition table, works on it there &
+// saves the result back. The UCI executable (below) is a shell over these functions.
 
-  for   (int current_move = 0; current_move < move_list->count; current_move++) {                                      // loop over current move within a move list
-    for (int next_move = current_move + 1; next_move < move_list->count; next_move++) {                                // loop over next move within a move list
-      if (move_scores[current_move] < move_scores[next_move]) {                                                        // compare current and next move scores
-        int temp_score = move_scores[current_move];                                                                    // swap scores
-        move_scores[current_move] = move_scores[next_move];
-        move_scores[next_move] = temp_score;
+struct bbc_position
+{
+  board_state* states;                                                                                                 // board state after each move, the current one last
+  int          count;                                                                                                  // states in use
+  int          capacity;                                                                                               // states allocated
+  int          first_move;                                                                                             // full move number of the first state
+};
 
-        int temp_move = move_list->moves[current_move];                                                                // swap moves
-        move_list->moves[current_move] = move_list->moves[next_move];
-        move_list->moves[next_move] = temp_move;
-      }
-    }
-  }
-}                                                                                                                      // ????
+pthread_once_t bbc_once = PTHREAD_ONCE_INIT;                                                                           // engine tables are initialized once per process
 
-// print move scores
+// make the position the board of the calling thread
 void
-print_move_scores(moves* move_list)
+load_position(bbc_position* position)
 {
-  printf("     Move scores:\n\n");
-
-  for (int count = 0; count < move_list->count; count++) {                                                             // loop over moves within a move list
-    printf("     move: ");
-    print_move(move_list->moves[count]);
-    printf(" score: %d\n", score_move(move_list->moves[count]));
-  }
+  board_state* current = &position->states[position->count - 1];
+  int          first   = position->count - 1 - current->fifty;                                                         // only positions since the last irreversible move can repeat
+
+  repetition_index = position->count - 1;
+  grow_repetition_table();
+  repetition_table[0] = 0ULL;
+  for (int index = first > 1 ? first : 1; index < position->count; index++)                                            // parent of the position of every move
+    repetition_table[index] = position->states[index - 1].hash_key;
+
+  restore_board(current);
+  nnue_ply = 0;
+  if (use_nnue) nnue_refresh();
 }
 
-// position repetition detection
+// append the board of the calling thread to the position's game, returns 0 (game unchanged) if out of memory
 int
-is_repetition()
+store_position(bbc_position* position)
 {
-  for (int index = 0; index < repetition_index; index++)                                                               // loop over repetition indicies range
-    if (repetition_table[index] == hash_key)                                                                           // if we found the hash key same with a current
-      return 1;                                                                                                        // we found a repetition
-
-  return 0;                                                                                                            // if no repetition found
+  if (position->count == position->capacity) {
+    int          capacity = position->capacity ? 2 * position->capacity : 64;
+    board_state* states   = realloc(position->states, capacity * sizeof(board_state));
+    if (states == NULL) return 0;                                                                                      // keep the old buffer
+    position->states   = states;
+    position->capacity = capacity;
+  }
+  save_board(&position->states[position->count]);
+  position->count++;
+  return 1;
 }
 
-// quiescence search
+// is the move one of the legal moves of the calling thread's board?
 int
-quiescence(int alpha, int beta)
+is_legal_move(int move)
 {
-  if ((nodes & 2047) == 0) communicate();                                                                              // every 2047 nodes; "listen" to the GUI/user input
-  nodes++;
-  if (ply > max_ply - 1) return evaluate();                                                                            // we are too deep, hence there's an overflow of arrays relying on max ply constant
-  int evaluation = evaluate();
-  if (evaluation >= beta)  return beta;                                                                                // fail-hard beta cutoff; node (position) fails high
-  if (evaluation >  alpha) alpha = evaluation;                                                                         // found a better move; PV node (position)
-  moves move_list[1];                                                                                                  // create move list instance
-  generate_moves(move_list);                                                                                           // generate moves
-  sort_moves(move_list);                                                                                               // sort moves
-
-  for (int count = 0; count < move_list->count; count++) {                                                             // loop over moves within a movelist
-    copy_board();                                                                                                      // preserve board state
-    ply++;
-    repetition_index++;                                                                                                // increment repetition index & store hash key
-    repetition_table[repetition_index] = hash_key;
-    if (make_move(move_list->moves[count], only_captures) == 0) {                                                      // make sure to make only legal moves
-      ply--;
-      repetition_index--;
-      continue;                                                                                                        // skip to next move
-    }
-    int score = -quiescence(-beta, -alpha);                                                                            // score current move
-    ply--;
-    repetition_index--;
-    take_back();                                                                                                       // take move back
-    if (stopped == 1) return 0;                                                                                        // return 0 if time is up
-    if (score > alpha) {                                                                                               // found a better move
-      alpha = score;                                                                                                   // PV node (position)
-      if (score >= beta) return beta;                                                                                  // fail-hard beta cutoff; node (position) fails high
-    }
+  moves move_list[1];
+  generate_moves(move_list);
+
+  for (int index = 0; index < move_list->count; index++) {
+    if (move_list->moves[index] != move) continue;                                                                     // make_move trusts its moves to be pseudo legal
+    copy_board();
+    if (make_move(move, all_moves) == 0) return 0;
+    take_back();
+    return 1;
   }
-  return alpha;                                                                                                        // node (position) fails low
+  return 0;
 }
 
-const int full_depth_moves = 4;                                                                                        // full depth moves counter
-const int reduction_limit  = 3;                                                                                        // depth limit to consider reduction
+BBC_API int
+bbc_api_version(void)
+{
+  return BBC_API_VERSION;
+}
 
-// negamax alpha beta search
-int
-negamax(int alpha, int beta, int depth)
+BBC_API int
+bbc_set_fen(bbc_position* position, const char* fen)
 {
-  int score;                                                                                                           // variable to store current move's score (from the static evaluation perspective)
-  int hash_flag = hash_flag_alpha;                                                                                     // define hash flag
+  char line[640], fields[520];
+  snprintf(line, sizeof(line), "%s", fen);
 
-  if (ply && is_repetition()) return 0;                                                                                // if position repetition occurs return draw score
+  repetition_index = 0;
+  grow_repetition_table();                                                                                             // parse_fen needs this thread's repetition table
+  if (parse_epd(line, fields) == 0) return 0;
 
-  int pv_node = beta - alpha > 1;                                                                                      // a hack by Pedro Castro to figure out whether the current node is PV node or not
+  int count = position->count, first_move = position->first_move;
 
-  if (ply && (score = read_hash_entry(alpha, beta, depth)) != no_hash_entry && pv_node == 0) return score;             // read hash entry if we're not in a root ply and hash entry is available and current node is not a PV node
-                                                                                                                       // if the move has already been searched we just return the score for this move without searching it
-  if ((nodes & 2047) == 0) communicate();                                                                              // every 2047 nodes "listen" to the GUI/user input
-  pv_length[ply] = ply;                                                                                                // init PV length
+  position->count      = 0;
+  position->first_move = 1;
+  sscanf(line, "%*s %*s %*s %*s %*d %d", &position->first_move);                                                       // FEN move counters are optional
+  if (store_position(position)) return 1;
 
-  if (depth == 0)        return quiescence(alpha, beta);                                                               // we are too deep, hence there's an overflow of arrays relying on max ply constant; run quiescence search
-  if (ply > max_ply - 1) return evaluate();                                                                            // evaluate position
+  position->count      = count;                                                                                        // out of memory: keep the old game
+  position->first_move = first_move;
+  return 0;
+}
 
-  nodes++;
+BBC_API bbc_position*
+bbc_position_new(const char* fen)
+{
+  pthread_once(&bbc_once, init_all);
 
-  int in_check = is_square_attacked((side == WHITE) ? get_ls1b_index(bitboards[K])                                     // is king in check
-                                                    : get_ls1b_index(bitboards[k]), side ^ 1);
+  bbc_position* position = calloc(1, sizeof(bbc_position));
+  if (position && bbc_set_fen(position, fen ? fen : start_position)) return position;
 
-  if (in_check) depth++;                                                                                               // increase search depth if the king has been exposed into a check
-  int legal_moves = 0;                                                                                                 // legal moves counter
+  bbc_position_free(position);
+  return NULL;
+}
 
-  if (depth >= 3 && in_check == 0 && ply) {                                                                            // null move pruning
-    copy_board();                                                                                                      // preserve board state
-    ply++;
-    repetition_index++;                                                                                                // increment repetition index & store hash key
-    repetition_table[repetition_index] = hash_key;
-    if (enpassant != no_sq) hash_key ^= enpassant_keys[enpassant];                                                     // hash enpassant if available
-    enpassant  = no_sq;                                                                                                // reset enpassant capture square
-    side      ^= 1;                                                                                                    // switch the side, literally giving opponent an extra move to make
-    hash_key  ^= side_key;                                                                                             // hash the side
-    score      = -negamax(-beta, -beta + 1, depth - 1 - 2);                                                            // search moves with reduced depth to find beta cutoffs depth - 1 - R where R is a reduction limit
-    ply--;
-    repetition_index--;                                                                                                // decrement repetition index
-    take_back();                                                                                                       // restore board state
-    if (stopped == 1)    return 0;                                                                                     // return 0 if time is up
-    if (score   >= beta) return beta;                                                                                  // fail-hard beta cutoff node (position) fails high
-  }
-  moves move_list[1];                                                                                                  // create move list instance
-  generate_moves(move_list);                                                                                           // generate moves
-  if (follow_pv) enable_pv_scoring(move_list);                                                                         // if we are now following PV line enable PV move scoring
-  sort_moves(move_list);                                                                                               // sort moves
-  int moves_searched = 0;                                                                                              // number of moves searched in a move list
+BBC_API void
+bbc_position_free(bbc_position* position)
+{
+  if (position == NULL) return;
+  free(position->states);
+  free(position);
+}
 
-  for (int count = 0; count < move_list->count; count++) {                                                             // loop over moves within a movelist
-    copy_board();                                                                                                      // preserve board state
-    ply++;
-    repetition_index++;                                                                                                // increment repetition index & store hash key
-    repetition_table[repetition_index] = hash_key;
+BBC_API int
+bbc_get_fen(bbc_position* position, char* buffer, int size)
+{
+  char fen[128];
 
-    if (make_move(move_list->moves[count], all_moves) == 0) {                                                          // make sure to make only legal moves
-      ply--;
-      repetition_index--;
-      continue;                                                                                                        // skip to next move
-    }
-    legal_moves++;
+  load_position(position);
+  generate_fen(fen, position->first_move + (position->count - 1 + position->states[0].side) / 2);
+  return snprintf(buffer, size, "%s", fen) < size;
+}
 
-    if (moves_searched == 0) score = -negamax(-beta, -alpha, depth - 1);                                               // full depth search do normal alpha beta search
-    else {                                                                                                             // late move reduction (LMR)
-      if (moves_searched >= full_depth_moves && depth >= reduction_limit &&                                            // condition to consider LMR
-          in_check == 0 && get_move_capture(move_list->moves[count]) == 0 &&
-          get_move_promoted(move_list->moves[count]) == 0)
-        score = -negamax(-alpha - 1, -alpha, depth - 2);                                                               // search current move with reduced depth:
-      else                                                                                                             // hack to ensure that full-depth search is done
-        score = alpha + 1;
+BBC_API int
+bbc_side_to_move(bbc_position* position)
+{
+  return position->states[position->count - 1].side;
+}
 
-      if (score > alpha) {                                                                                             // principle variation search PVS
-        score = -negamax(-alpha - 1, -alpha, depth - 1);                                                               // Once you've found a move with a score that is between alpha and beta,
-                                                                                                                       // the rest of the moves are searched with the goal of proving that they
-                                                                                                                       // are all bad. It's possible to do this a bit faster than a search that
-                                                                                                                       // worries that one of the remaining moves might be good.
+BBC_API int
+bbc_in_check(bbc_position* position)
+{
+  load_position(position);
+  return is_square_attacked(get_ls1b_index(bitboards[side == WHITE ? K : k]), side ^ 1);
+}
 
-        if ((score > alpha) && (score < beta))                                                                         // If the algorithm finds out that it was wrong, and that one of the
-                                                                                                                       // subsequent moves was better than the first PV move, it has to search
-                                                                                                                       // again, in the normal alpha-beta manner.  This happens sometimes, and
-                                                                                                                       // it's a waste of time, but generally not often enough to counteract
-                                                                                                                       // the savings gained from doing the "bad move proof" search referred to earlier.
-          score = -negamax(-beta, -alpha, depth - 1);                                                                  // re-search the move that has failed to be proved to be bad with normal alpha beta score bounds
-      }
-    }
+BBC_API int
+bbc_legal_moves(bbc_position* position, int* legal_moves, int capacity)
+{
+  moves move_list[1];
+  int   count = 0;
+
+  load_position(position);
+  generate_moves(move_list);
+  for (int index = 0; index < move_list->count; index++) {
+    copy_board();
+    if (make_move(move_list->moves[index], all_moves) == 0) continue;                                                  // illegal moves are taken back by make_move
+    take_back();
+    if (count < capacity) legal_moves[count] = move_list->moves[index];
+    count++;
+  }
+  return count < capacity ? count : capacity;
+}
 
-    ply--;
-    repetition_index--;
-    take_back();                                                                                                       // take move back
+BBC_API int
+bbc_parse_move(bbc_position* position, const char* uci_move)
+{
+  char move_string[8] = "";
+  strncpy(move_string, uci_move, 5);
+  if (strlen(move_string) < 4) return 0;
+
+  load_position(position);
+  int move = parse_move(move_string);
+  if (move == 0) return 0;
+
+  copy_board();
+  if (make_move(move, all_moves) == 0) return 0;
+  take_back();
+  return move;
+}
 
-    if (stopped == 1) return 0;                                                                                        // return 0 if time is up
+BBC_API void
+bbc_move_to_uci(int move, char* buffer)
+{
+  move_to_string(move, buffer);
+}
 
-    moves_searched++;                                                                                                  // increment the counter of moves searched so far
+BBC_API int
+bbc_make_move(bbc_position* position, int move)
+{
+  load_position(position);
+  if (is_legal_move(move) == 0) return 0;
 
-    if (score > alpha) { 
-      hash_flag = hash_flag_exact;                                                                                     // found a better move switch hash flag from storing score for fail-low node to the one storing score for PV node
+  make_move(move, all_moves);
+  return store_position(position);
+}
 
-      if (get_move_capture(move_list->moves[count]) == 0)                                                              // on quiet moves
-        history_moves[get_move_piece (move_list->moves[count])]
-                     [get_move_target(move_list->moves[count])] += depth;                                              // store history moves
+BBC_API int
+bbc_unmake_move(bbc_position* position)
+{
+  if (position->count == 1) return 0;
+  position->count--;
+  return 1;
+}
 
-      alpha = score;                                                                                                   // PV node (position)
-      pv_table[ply][ply] = move_list->moves[count];                                                                    // write PV move
+BBC_API int
+bbc_evaluate(bbc_position* position)
+{
+  load_position(position);
+  return evaluate();
+}
 
-      for (int next_ply = ply + 1; next_ply < pv_length[ply + 1]; next_ply++)                                          // loop over the next ply
-        pv_table[ply][next_ply] = pv_table[ply + 1][next_ply];                                                         // copy move from deeper ply into a current ply's line
+BBC_API int
+bbc_search_limits(bbc_position* position, const bbc_limits* limits, bbc_search_result* result)
+{
+  int old_verbose = verbose, old_gui_input = gui_input;
+  int depth       = limits->depth > 0 && limits->infinite == 0 ? limits->depth : 64;
+  int move        = 0;
+
+  load_position(position);
+  verbose     = limits->uci_output;                                                                                    // the host owns stdin & stdout (unless it wants UCI output)
+  gui_input   = 0;
+  search_poll = limits->poll;
+  starttime   = get_time_ms();
+  stopnodes   = limits->infinite ? 0 : limits->nodes;
+  timeset     = 0;
+
+  if (limits->infinite == 0 && (limits->movetime > 0 || limits->time > 0)) {                                           // time control
+    int time = limits->movetime > 0 ? limits->movetime : limits->time / (limits->movestogo > 0 ? limits->movestogo : 30);
+    if (time > 1500) time -= 50;                                                                                       // "illegal" (empty) move bug fix
+    timeset  = 1;
+    stoptime = starttime + time + limits->increment;
+  }
 
-      pv_length[ply] = pv_length[ply + 1];                                                                             // adjust PV length
+  search_moves_count = 0;
+  for (int index = 0; index < limits->searchmoves_count && search_moves_count < 256; index++)                          // keep only legal moves
+    if (is_legal_move(limits->searchmoves[index])) search_moves[search_moves_count++] = limits->searchmoves[index];
 
-      if (score >= beta) {                                                                                             // fail-hard beta cutoff
-        write_hash_entry(beta, depth, hash_flag_beta);                                                                 // store hash entry with the score equal to beta
+  if (verbose)
+    printf("time:%d start:%d stop:%d depth:%d timeset:%d\n",                                                           // print debug info
+           timeset ? stoptime - starttime : -1, starttime, stoptime, depth, timeset);
 
-        if (get_move_capture(move_list->moves[count]) == 0) {                                                          // on quiet moves
-          killer_moves[1][ply] = killer_moves[0][ply];                                                                 // store killer moves
-          killer_moves[0][ply] = move_list->moves[count];
-        }
-        return beta;                                                                                                   // node (position) fails high
-      }
-    }
-  }
+  if (own_book && limits->mate <= 0 && search_moves_count == 0) move = book_move();                                    // play from the opening book
 
-  if (legal_moves == 0) {                                                                                              // we don't have any legal moves to make in the current postion
-    if (in_check)                                                                                                      // king is in check
-      return -mate_value + ply;                                                                                        // return mating score (assuming closest distance to mating position)
-    else                                                                                                               // king is not in check
-      return 0;                                                                                                        // return stalemate score
+  if (move) {
+    search_move = move, search_score = 0, search_depth = 0, nodes = 0;
+    if (verbose) {
+      printf("bestmove ");
+      print_move(move);
+      printf("\n");
+    }
   }
-
-  write_hash_entry(alpha, depth, hash_flag);                                                                           // store hash entry with the score equal to alpha
-  return alpha;                                                                                                        // node (position) fails low
+  else if (limits->mate > 0) search_mate(limits->mate);                                                                // prove a mate with the mate searcher
+  else                       search_position(depth);
+
+  search_moves_count = 0;                                                                                              // (search_mate doesn't clear them)
+  stopnodes          = 0;
+  search_poll        = NULL;
+  verbose            = old_verbose;
+  gui_input          = old_gui_input;
+
+  result->move  = search_move;
+  result->score = search_score;
+  result->mate  = 0;
+  if      (search_score > -mate_value && search_score < -mate_score) result->mate = -(search_score + mate_value) / 2 - 1;
+  else if (search_score >  mate_score && search_score <  mate_value) result->mate =  (mate_value - search_score) / 2 + 1;
+  result->depth = search_depth;
+  result->nodes = nodes;
+  result->time  = get_time_ms() - starttime;
+  return search_move != 0;
 }
 
-// search position for the best move
-void
-search_position(int depth)
+BBC_API int
+bbc_search(bbc_position* position, int depth, int movetime, bbc_search_result* result)
 {
-  int score = 0;                                                                                                       // define best score variable
-  nodes     = 0;                                                                                                       // reset nodes counter
-  stopped   = 0;                                                                                                       // reset "time is up" flag
-  follow_pv = 0;                                                                                                       // reset follow PV flags
-  score_pv  = 0;
-
-  memset(killer_moves,  0, sizeof(killer_moves));                                                                      // clear helper data structures for search
-  memset(history_moves, 0, sizeof(history_moves));
-  memset(pv_table,      0, sizeof(pv_table));
-  memset(pv_length,     0, sizeof(pv_length));
-
-  int alpha = -infinity;                                                                                               // define initial alpha beta bounds
-  int beta  = infinity;
-
-  for (int current_depth = 1; current_depth <= depth; current_depth++) {                                               // iterative deepening
-    if (stopped == 1)                                                                                                  // if time is up
-      break;                                                                                                           // stop calculating and return best move so far
-
-    follow_pv = 1;                                                                                                     // enable follow PV flag
-
-    score = negamax(alpha, beta, current_depth);                                                                       // find best move within a given position
+  bbc_limits limits = { 0 };
 
-    if ((score <= alpha) || (score >= beta)) {                                                                         // we fell outside the window, so try again with a full-width window (and the same depth)
-      alpha = -infinity;
-      beta  =  infinity;
-      continue;
-    }
-
-    // set up the window for the next iteration
-    alpha = score - 50;
-    beta  = score + 50;
+  limits.depth    = depth > 0 || movetime > 0 ? depth : batch_default_depth;
+  limits.movetime = movetime;
+  return bbc_search_limits(position, &limits, result);
+}
 
-    // print search info
-    if      (score > -mate_value && score < -mate_score) printf("info score mate %d depth %d nodes %lld time %d pv ", -(score + mate_value) / 2 - 1, current_depth, nodes, get_time_ms() - starttime);
-    else if (score >  mate_score && score <  mate_value) printf("info score mate %d depth %d nodes %lld time %d pv ",  (mate_value - score) / 2 + 1, current_depth, nodes, get_time_ms() - starttime);
-    else                                                 printf("info score cp %d depth %d nodes %lld time %d pv ",    score, current_depth, nodes, get_time_ms() - starttime);
+BBC_API void
+bbc_stop(void)
+{
+  __atomic_add_fetch(&stop_requests, 1, __ATOMIC_RELAXED);                                                             // every search polling after this stops
+}
 
-    for (int count = 0; count < pv_length[0]; count++) {                                                               // loop over the moves within a PV line
-      print_move(pv_table[0][count]);                                                                                  // print PV move
-      printf(" ");
-    }
-    printf("\n");
-  }
+BBC_API void
+bbc_set_option(const char* name, const char* value)
+{
+  char command[1200];
 
-  printf("bestmove ");
-  print_move(pv_table[0][0]);
-  printf("\n");
+  pthread_once(&bbc_once, init_all);
+  snprintf(command, sizeof(command), "setoption name %s value %s", name, value);
+  parse_setoption(command);
 }
 
-//        UCI
-//  forked from VICE
-// by Richard Allbert
+// Main driver
 
-// parse user/GUI move string input (e.g. "e7e8q")
-int
-parse_move(char* move_string)
-{
-  moves move_list[1];                                                                                                  // create move list instance
-  generate_moves(move_list);                                                                                           // generate moves
+#ifndef BBC_LIBRARY
 
-  int source_square = (move_string[0] - 'a') + (8 - (move_string[1] - '0')) * 8;                                       // parse source square
-  int target_square = (move_string[2] - 'a') + (8 - (move_string[3] - '0')) * 8;                                       // parse target square
+// UCI shell: "position" & "go" drive a bbc_position through the library API
 
-  for (int move_count = 0; move_count < move_list->count; move_count++) {                                              // loop over the moves within a move list
-    int move = move_list->moves[move_count];                                                                           // init move
+bbc_position* uci_game;                                                                                                // game set up by "position"
 
-    if (source_square == get_move_source(move) &&                                                                      // make sure source & target squares are available within the generated move
-        target_square == get_move_target(move)) {
-      int promoted_piece = get_move_promoted(move);                                                                    // init promoted piece
+// poll GUI input during a search: any input stops it ("quit" ends the UCI loop as well)
+void
+uci_poll()
+{
+  char input[256] = "";
 
-      if (promoted_piece) {                                                                                            // promoted piece is available
-        if      ((promoted_piece == Q || promoted_piece == q) && move_string[4] == 'q') return move;                   // promoted to queen
-        else if ((promoted_piece == R || promoted_piece == r) && move_string[4] == 'r') return move;                   // promoted to rook
-        else if ((promoted_piece == B || promoted_piece == b) && move_string[4] == 'b') return move;                   // promoted to bishop
-        else if ((promoted_piece == N || promoted_piece == n) && move_string[4] == 'n') return move;                   // promoted to knight
-        continue;                                                                                                      // continue the loop on possible wrong promotions (e.g. "e7e8f")
-      }
-      return move;                                                                                                     // return legal move
-    }
-  }
-  return 0;                                                                                                            // return illegal move
+  if (input_waiting() == 0) return;
+  if (read(fileno(stdin), input, sizeof(input) - 1) <= 0) return;                                                      // end of input (e.g. "bbc < file"); keep calculating
+  if (strncmp(input, "quit", 4) == 0) quit = 1;
+  bbc_stop();
 }
 
 // parse UCI "position" command
 void
 parse_position(char* command)
 {
-  command += 9;                                                                                                        // shift pointer to the right where next token begins
-  char* current_char = command;                                                                                        // init pointer to the current character in the command string
+  char  fen[640] = start_position;
+  char* moves    = strstr(command, "moves");                                                                           // moves after the position
+  char* found    = strstr(command, "fen");
 
-  if (strncmp(command, "startpos", 8) == 0) parse_fen(start_position);                                                 // init chess board with start position
-  else {
-    current_char = strstr(command, "fen");                                                                             // make sure "fen" command is available within command string
-    if (current_char == NULL) parse_fen(start_position);                                                               // if no "fen" command is available within command string init chess board with start position
-    else {                                                                                                             // found "fen" substring
-      current_char += 4;                                                                                               // shift pointer to the right where next token begins
-      parse_fen(current_char);                                                                                         // init chess board with position from FEN string
-    }
+  if (strncmp(command + 9, "startpos", 8) && found) {                                                                  // position from a FEN string (up to the moves)
+    found += 4;
+    snprintf(fen, sizeof(fen), "%.*s", moves && moves > found ? (int)(moves - found) : (int)strlen(found), found);
+  }
+  if (bbc_set_fen(uci_game, fen) == 0) {
+    printf("info string invalid FEN, using the start position\n");
+    bbc_set_fen(uci_game, start_position);
   }
 
-  current_char = strstr(command, "moves");                                                                             // parse moves after position
-
-  if (current_char != NULL) {                                                                                          // moves available
-    current_char += 6;                                                                                                 // shift pointer to the right where next token begins
+  if (moves)
+    for (char* move = strtok(moves + 5, " "); move; move = strtok(NULL, " "))                                          // loop over moves within a move string
+      if (bbc_make_move(uci_game, bbc_parse_move(uci_game, move)) == 0) break;                                         // up to the first illegal one
 
-    while (*current_char) {                                                                                            // loop over moves within a move string
-      int move = parse_move(current_char);                                                                             // parse next move
-      if (move == 0) break;                                                                                            // if no more moves break out of the loop
-      repetition_index++;
-      repetition_table[repetition_index] = hash_key;                                                                   // write hash key into a repetition table
-      make_move(move, all_moves);                                                                                      // make move on the chess board
-      while (*current_char && *current_char != ' ') current_char++;                                                    // move current character mointer to the end of current move
-      current_char++;                                                                                                  // go to the next move
-    }
-  }
+  load_position(uci_game);
   print_board();
 }
 
@@ -2340,44 +6130,36 @@ parse_position(char* command)
 void
 parse_go(char* command)
 {
-  int depth = -1; // init parameters
-  char* argument = NULL; // init argument
-
-  if ((argument = strstr(command, "infinite")))                { }                                                     // infinite search
-  if ((argument = strstr(command, "binc"))  && side == BLACK)  inc       = atoi(argument +  5);                        // parse black time increment
-  if ((argument = strstr(command, "winc"))  && side == WHITE)  inc       = atoi(argument +  5);                        // parse white time increment
-  if ((argument = strstr(command, "wtime")) && side == WHITE)  time      = atoi(argument +  6);                        // parse white time limit
-  if ((argument = strstr(command, "btime")) && side == BLACK)  time      = atoi(argument +  6);                        // parse black time limit
-  if ((argument = strstr(command, "movestogo")))               movestogo = atoi(argument + 10);                        // parse number of moves to go
-  if ((argument = strstr(command, "movetime")))                movetime  = atoi(argument +  9);                        // parse amount of time allowed to spend to make a move
-  if ((argument = strstr(command, "depth")))                   depth     = atoi(argument +  6);                        // parse search depth
-
-  if (movetime != -1) {                                                                                                // if move time is not available
-    time = movetime;                                                                                                   // set time equal to move time
-    movestogo = 1;                                                                                                     // set moves to go to 1
-  }
-
-  starttime = get_time_ms();                                                                                           // init start time
-  depth     = depth;                                                                                                   // init search depth
-
-  if (time != -1) {                                                                                                    // if time control is available
-    timeset                = 1;                                                                                        // flag we're playing with time control
-    time                  /= movestogo;                                                                                // set up timing
-    if (time > 1500) time -= 50;                                                                                       // "illegal" (empty) move bug fix
-    stoptime               = starttime + time + inc;                                                                   // init stoptime
+  bbc_limits        limits = { 0 };
+  bbc_search_result result;
+  int               searchmoves[256];
+  int               white    = bbc_side_to_move(uci_game) == 0;
+  char*             argument = NULL;                                                                                   // init argument
+
+  limits.uci_output = 1;
+  limits.poll       = uci_poll;
+
+  if ((argument = strstr(command, "infinite")))                limits.infinite  = 1;                                   // infinite search
+  if ((argument = strstr(command, "binc"))  && !white)         limits.increment = atoi(argument +  5);                 // parse black time increment
+  if ((argument = strstr(command, "winc"))  &&  white)         limits.increment = atoi(argument +  5);                 // parse white time increment
+  if ((argument = strstr(command, "wtime")) &&  white)         limits.time      = atoi(argument +  6);                 // parse white time limit
+  if ((argument = strstr(command, "btime")) && !white)         limits.time      = atoi(argument +  6);                 // parse black time limit
+  if ((argument = strstr(command, "movestogo")))               limits.movestogo = atoi(argument + 10);                 // parse number of moves to go
+  if ((argument = strstr(command, "movetime")))                limits.movetime  = atoi(argument +  9);                 // parse amount of time allowed to spend to make a move
+  if ((argument = strstr(command, "mate")))                    limits.mate      = atoi(argument +  5);                 // parse mate in N moves
+  if ((argument = strstr(command, "depth")))                   limits.depth     = atoi(argument +  6);                 // parse search depth
+  if ((argument = strstr(command, "nodes")))                   limits.nodes     = atoll(argument + 6);                 // parse node limit
+
+  if ((argument = strstr(command, "searchmoves"))) {                                                                   // parse root moves to search
+    limits.searchmoves = searchmoves;
+    for (argument = strtok(argument + 11, " "); argument && limits.searchmoves_count < 256; argument = strtok(NULL, " ")) {
+      if (argument[0] < 'a' || argument[0] > 'h' || argument[1] < '1' || argument[1] > '8') break;                     // not a move string
+      int move = bbc_parse_move(uci_game, argument);
+      if (move) searchmoves[limits.searchmoves_count++] = move;                                                        // keep only legal moves
+    }
   }
 
-  if (depth == -1)                                                                                                     // if depth is not available
-    depth = 64;                                                                                                        // set depth to 64 plies (takes ages to complete...)
-
-  printf("time:%d start:%d stop:%d depth:%d timeset:%d\n",                                                             // print debug info
-         time,
-         starttime,
-         stoptime,
-         depth,
-         timeset);
-
-  search_position(depth);                                                                                              // search position
+  bbc_search_limits(uci_game, &limits, &result);                                                                       // prints "info" & "bestmove"
 }
 
 // main UCI loop
@@ -2386,7 +6168,8 @@ uci_loop()
 {
   setbuf(stdin, NULL);                                                                                                 // reset STDIN & STDOUT buffers
   setbuf(stdout, NULL);
-  char input[2000];                                                                                                    // define user / GUI input buffer
+  char input[20000];                                                                                                   // define user / GUI input buffer
+  uci_game = bbc_position_new(NULL);
   printf("id name BBC\n");                                                                                             // print engine info
   printf("id name Code Monkey King\n");
   printf("uciok\n");
@@ -2395,43 +6178,53 @@ uci_loop()
     memset(input, 0, sizeof(input));                                                                                   // reset user /GUI input
     fflush(stdout);                                                                                                    // make sure output reaches the GUI
 
-    if (!fgets(input, 2000, stdin)) continue;                                                                          // get user / GUI input
-    if (input[0] == '\n') continue;                                                                                    // make sure input is available
+    if (quit) break;                                                                                                   // "quit" arrived during a search
+    if (!fgets(input, 20000, stdin)) continue;                                                                         // get user / GUI input
+    input[strcspn(input, "\r\n")] = 0;
+    if (input[0] == 0) continue;                                                                                       // make sure input is available
 
     if      (strncmp(input, "isready",     7) == 0) { printf("readyok\n"); continue; }
     else if (strncmp(input, "position",    8) == 0) { parse_position(input); clear_hash_table(); }
-    else if (strncmp(input, "ucinewgame", 10) == 0) { parse_position("position startpos"); clear_hash_table(); }
+    else if (strncmp(input, "ucinewgame", 10) == 0) { bbc_set_fen(uci_game, start_position); clear_hash_table(); }
     else if (strncmp(input, "go",          2) == 0)  parse_go(input);
-    else if (strncmp(input, "quit",        4) == 0)  break; // quit from the chess engine program execution
-    else if (strncmp(input, "uci",         3) == 0) { printf("id name BBC\nid name Code Monkey King\nuciok\n"); }
+    else if (strncmp(input, "setoption",   9) == 0)  parse_setoption(input);
+    else if (strncmp(input, "bench",       5) == 0)  bench(input[5] == ' ' ? atoi(input + 6) : bench_depth);
+    else if (strncmp(input, "quit",        4) == 0)  break;                                                            // quit from the chess engine program execution
+    else if (strncmp(input, "uci",         3) == 0) { printf("id name BBC\nid name Code Monkey King\n"); print_options(); printf("uciok\n"); }
   }
+  bbc_position_free(uci_game);
 }
 
-// init all variables
-void
-init_all()
-{
-  init_leapers_attacks();                                                                                              // init leaper pieces attacks
-  init_sliders_attacks(BISHOP);                                                                                        // init slider pieces attacks
-  init_sliders_attacks(ROOK);
-  init_random_keys();                                                                                                  // init random keys for hashing purposes
-  clear_hash_table();                                                                                                  // clear hash table
-  init_evaluation_masks();                                                                                             // init evaluation masks
-}
-
-// Main driver
 
 int
-main()
+main(int argc, char* argv[])
 {
-  Bitboard block = 0ULL;
-  set_bit(block, d7);
-  set_bit(block, e4);
-  set_bit(block, g7);
-  for (Square square = 0; square < 64; square++) {
-    printf("Square %d\n", square);
-    print_bitboard(rook_attacks_on_the_fly(square, block));
-  }
-  // init_all();
-  // uci_loop();                                                                                                          // connect to GUI
+  pthread_once(&bbc_once, init_all);                                                                                   // (the UCI shell's library calls won't init again)
+
+  if (argc > 1 && strcmp(argv[1], "bench") == 0)                                                                       // "bbc bench [depth]" runs the bench and exits
+    bench(argc > 2 ? atoi(argv[2]) : bench_depth);
+  else if (argc > 3 && strcmp(argv[1], "pack") == 0)                                                                   // "bbc pack <EPD/FEN in> <packed out>" ("-" for stdin/stdout)
+    convert_positions(argv[2], argv[3], 1);
+  else if (argc > 3 && strcmp(argv[1], "unpack") == 0)                                                                 // "bbc unpack <packed in> <FEN out>"
+    convert_positions(argv[2], argv[3], 0);
+  else if (argc > 3 && strcmp(argv[1], "perft") == 0)                                                                  // "bbc perft <file.packed> <depth>"
+    perft_file(argv[2], atoi(argv[3]));
+  else if (argc > 2 && strcmp(argv[1], "batch") == 0)                                                                  // "bbc batch <file or -> [depth] [threads] [json|csv]"
+    batch(argv[2],
+          argc > 3 ? atoi(argv[3]) : batch_default_depth,
+          argc > 4 ? atoi(argv[4]) : 0,
+          argc > 5 && strcmp(argv[5], "csv") == 0);
+  else if (argc > 2 && strcmp(argv[1], "match") == 0)                                                                  // "bbc match <openings> [games] [nodes|<ms>ms] [threads] [test] [base] [elo0] [elo1]"
+    match(argv[2],
+          argc > 3 ? atoi(argv[3]) : match_default_games,
+          argc > 4 ? argv[4] : NULL,
+          argc > 5 ? atoi(argv[5]) : 0,
+          argc > 6 ? argv[6] : "-",
+          argc > 7 ? argv[7] : "-",
+          argc > 8 ? atof(argv[8]) : 0,
+          argc > 9 ? atof(argv[9]) : 5);
+  else
+    uci_loop();                                                                                                        // connect to GUI
 }
+
+#endif
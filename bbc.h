@@ -0,0 +1,71 @@
+// BBC library API
+//
+// Build the engine as a shared library (no main, only the bbc_* symbols exported) with "make libbbc.so".
+//
+// A bbc_position holds a game: the current position plus the positions before it (for undo & repetitions). Every call
+// loads the position into the calling thread's board & search state, so any number of threads may search their own
+// positions at the same time (one thread per position at a time). All threads share the transposition table.
+// Moves are the engine's move codes: take them from bbc_legal_moves or bbc_parse_move of the same position.
+// A search runs until its limits are reached or bbc_stop is called (from another thread, or from the limits' poll).
+
+#ifndef BBC_H
+#define BBC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BBC_API_VERSION 1                                                                                              /* bumped on incompatible changes */
+#define BBC_API         __attribute__((visibility("default")))
+
+typedef struct bbc_position bbc_position;                                                                              // opaque game state
+
+typedef struct                                                                                                         // search result
+{
+  int       move;                                                                                                      // best move (0 if there is no legal move)
+  int       score;                                                                                                     // centipawns from the side to move's point of view
+  int       mate;                                                                                                      // moves to mate (negative if getting mated, 0 if no mate found)
+  int       depth;                                                                                                     // depth of the last completed iteration
+  long long nodes;                                                                                                     // nodes searched
+  int       time;                                                                                                      // milliseconds spent
+} bbc_search_result;
+
+typedef struct                                                                                                         // search limits (0 or NULL: no limit)
+{
+  int        depth;                                                                                                    // plies
+  int        movetime;                                                                                                 // milliseconds for this move
+  int        time;                                                                                                     // milliseconds left on the side to move's clock
+  int        increment;                                                                                                // milliseconds it gains per move
+  int        movestogo;                                                                                                // moves until the next time control (0: 30)
+  long long  nodes;                                                                                                    // nodes searched
+  int        mate;                                                                                                     // prove a mate in this many moves with the mate searcher instead
+  int        infinite;                                                                                                 // ignore all limits, search until bbc_stop
+  const int* searchmoves;                                                                                              // search only these moves of the position
+  int        searchmoves_count;
+  int        uci_output;                                                                                               // print UCI "info" & "bestmove" lines on stdout
+  void     (*poll)(void);                                                                                              // called during the search (e.g. to read input & call bbc_stop)
+} bbc_limits;
+
+BBC_API int           bbc_api_version(void);                                                                           // BBC_API_VERSION the library was built with
+BBC_API bbc_position* bbc_position_new(const char* fen);                                                               // new game from a FEN (NULL: start position), NULL if invalid
+BBC_API void          bbc_position_free(bbc_position* position);
+BBC_API int           bbc_set_fen(bbc_position* position, const char* fen);                                            // restart the game from a FEN, 0 if invalid (or out of memory)
+BBC_API int           bbc_get_fen(bbc_position* position, char* buffer, int size);                                     // current FEN, 0 if the buffer is too small
+BBC_API int           bbc_side_to_move(bbc_position* position);                                                        // 0 white, 1 black
+BBC_API int           bbc_in_check(bbc_position* position);
+BBC_API int           bbc_legal_moves(bbc_position* position, int* moves, int capacity);                               // fills up to capacity moves, returns their count
+BBC_API int           bbc_parse_move(bbc_position* position, const char* uci_move);                                    // legal move of a UCI string like "e7e8q", 0 if none
+BBC_API void          bbc_move_to_uci(int move, char* buffer);                                                         // UCI string of a move (buffer of 6 chars)
+BBC_API int           bbc_make_move(bbc_position* position, int move);                                                 // 0 if the move is not legal (or out of memory)
+BBC_API int           bbc_unmake_move(bbc_position* position);                                                         // 0 if there is no move to take back
+BBC_API int           bbc_evaluate(bbc_position* position);                                                            // static evaluation (side to move's point of view)
+BBC_API int           bbc_search(bbc_position* position, int depth, int movetime, bbc_search_result* result);          // depth & time (ms) limits (0: none, both 0: depth 8)
+BBC_API int           bbc_search_limits(bbc_position* position, const bbc_limits* limits, bbc_search_result* result);  // UCI "go" limits (all 0: until bbc_stop); OwnBook applies
+BBC_API void          bbc_stop(void);                                                                                  // stop the searches in progress (any thread)
+BBC_API void          bbc_set_option(const char* name, const char* value);                                             // UCI option (not while searching)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif